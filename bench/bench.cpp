@@ -0,0 +1,321 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <lube.h>
+#include "ssp/ssp.h"
+#include "ssp/ar.h"
+#include "ssp/arcodec.h"
+#include "ssp/cochlea.h"
+#include "ssp/filter.h"
+#include "ssp/resample.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Count every heap allocation in the program, the library included, so
+ * the benchmarks can say whether a kernel allocates per call.  The array
+ * forms default to these.
+ */
+static atomic<long> sHeapAllocs(0);
+
+void* operator new(size_t iSize)
+{
+    sHeapAllocs++;
+    void* p = malloc(iSize ? iSize : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* iPtr) noexcept
+{
+    free(iPtr);
+}
+
+namespace
+{
+    double sMinTime = 0.2;
+    string sFilter;
+
+    /**
+     * Runs iFunc repeatedly for at least sMinTime seconds after one warm up
+     * call, then reports the time per frame and the throughput in samples.
+     * Each call of iFunc is taken to process iFrames frames spanning
+     * iSamples samples; for sample by sample kernels they're the same.
+     */
+    template <class F>
+    void run(const string& iName, long iFrames, long iSamples, F iFunc)
+    {
+        if (!sFilter.empty() && (iName.find(sFilter) == string::npos))
+            return;
+        iFunc();
+        typedef chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        long iter = 0;
+        double elapsed = 0.0;
+        do
+        {
+            iFunc();
+            iter++;
+            chrono::duration<double> d = clock::now() - start;
+            elapsed = d.count();
+        }
+        while (elapsed < sMinTime);
+        double perCall = elapsed / iter;
+        printf(
+            "%-32s %10ld %12.1f ns/frame %14.0f samples/s\n",
+            iName.c_str(), iter,
+            perCall / iFrames * 1e9, iSamples / perCall
+        );
+        fflush(stdout);
+    }
+
+    string name(const char* iKernel, const char* iArg, int iValue)
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s/%s:%d", iKernel, iArg, iValue);
+        return buf;
+    }
+
+    /**
+     * Something vaguely voiced: a sawtooth with a gliding pitch plus a
+     * little noise.  Fixed seed so runs are comparable.
+     */
+    var signal(int iSize, float iRate)
+    {
+        var s = lube::view({iSize}, 0.0f);
+        float* x = s.ptr<float>();
+        mt19937 gen(1);
+        normal_distribution<float> noise(0.0f, 0.01f);
+        double phase = 0.0;
+        for (int i=0; i<iSize; i++)
+        {
+            float f0 = 100.0f + 50.0f * sin(2.0 * PI * i / iRate);
+            phase += f0 / iRate;
+            phase -= floor(phase);
+            x[i] = 0.5f * (phase - 0.5f) + noise(gen);
+        }
+        return s;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    lube::Option opt("ssp-bench: libssp kernel benchmarks");
+    opt(" [<filter>] runs only benchmarks whose name contains <filter>");
+    opt('t', "Minimum time in seconds per benchmark", "0.2");
+    opt.parse(argc, argv);
+    sMinTime = opt['t'].cast<double>();
+    var arg = opt.args();
+    if (arg.size() > 0)
+        sFilter = arg[0].str();
+
+    PCM pcm;
+    float rate = pcm.rate();
+    int nSamples = (int)rate * 2;
+    var x = signal(nSamples, rate);
+
+    printf(
+        "%-32s %10s %21s %24s\n",
+        "Benchmark", "Iterations", "Time", "Throughput"
+    );
+
+    // Framing and overlap-add.  The direct autocorrelation gets the lags of
+    // an AR analysis at this rate; the periodogram gets all of them.
+    int sizes[] = {160, 256, 400, 512, 1024};
+    int lags = arorder(rate) + 1;
+    for (int size : sizes)
+    {
+        Frame frame(size, size/2);
+        var f = frame(x);
+        int nFrames = f.shape(0);
+        run(name("Frame", "size", size), nFrames, nSamples, [&]{
+            frame(x);
+        });
+        OverlapAdd ola(size/2);
+        run(name("OverlapAdd", "size", size), nFrames, nSamples, [&]{
+            ola(f);
+        });
+        Autocorrelation ac(lags);
+        run(name("Autocorrelation", "size", size), nFrames, nSamples, [&]{
+            ac(f);
+        });
+        AutocorrelationP acp(size);
+        run(name("AutocorrelationP", "size", size), nFrames, nSamples, [&]{
+            acp(f);
+        });
+    }
+
+    // AR analysis and synthesis at the codec's framing
+    int period = pcm.secondsToSamples(0.005, PCM::AT_LEAST);
+    Frame frame(period*2, period);
+    var f = frame(x);
+    int nFrames = f.shape(0);
+    int orders[] = {10, 16, 24, 32};
+    for (int order : orders)
+    {
+        Autocorrelation acorr(order+1);
+        var ac = acorr(f);
+        Levinson lev(order);
+        run(name("Levinson", "order", order), nFrames, nSamples, [&]{
+            lev(ac);
+        });
+        var ar = lev(ac);
+        Gain gain(order);
+        var gg = gain(ac, ar);
+        Spectrum spec(order, 129);
+        run(name("Spectrum", "order", order), nFrames, nSamples, [&]{
+            spec(ar, gg);
+        });
+        ToLSP toLSP(order);
+        run(name("ToLSP", "order", order), nFrames, nSamples, [&]{
+            toLSP(ar);
+        });
+        var lsp = toLSP(ar);
+        FromLSP fromLSP(order);
+        run(name("FromLSP", "order", order), nFrames, nSamples, [&]{
+            fromLSP(lsp);
+        });
+    }
+
+    // Direct form filter; a moving average with one pole of feedback.  The
+    // denominator starts with the 1.0 that core::Filter discards, and the
+    // rest is there so the recursion runs over the whole order.
+    float* y = new float[nSamples];
+    float* xp = x.ptr<float>();
+    for (int order : orders)
+    {
+        float numer[order+1];
+        float denom[order+1];
+        for (int i=0; i<=order; i++)
+            numer[i] = 1.0f / (order+1);
+        for (int i=0; i<=order; i++)
+            denom[i] = (i == 0) ? 1.0f : (i == 1) ? -0.5f : 0.0f;
+        core::Filter filter(order+1, numer, order+1, denom);
+        run(name("Filter", "order", order), nSamples, nSamples, [&]{
+            filter(nSamples, xp, y);
+        });
+    }
+    delete [] y;
+
+    // Sample rate conversion to the benchmark rate
+    int from[] = {8000, 44100, 48000};
+    for (int f : from)
+    {
+        core::Resampler resampler(f, (int)rate);
+        float* r = new float[resampler.outputs(nSamples) + 2];
+        run(name("Resampler", "from", f), nSamples, nSamples, [&]{
+            resampler(nSamples, xp, r);
+        });
+        delete [] r;
+    }
+
+    // Cochlear filterbanks, sample by sample
+    int channels[] = {16, 32, 64, 128};
+    for (int nChannels : channels)
+    {
+        float out[nChannels];
+        float hiHz = rate / 2 * 0.9f;
+        float T = 1.0f / rate;
+        Holdsworth holdsworth(50.0f, hiHz, nChannels, T);
+        run(name("Holdsworth", "channels", nChannels), nSamples, nSamples, [&]{
+            for (int i=0; i<nSamples; i++)
+                holdsworth(xp[i], out);
+        });
+        Lyon lyon(50.0f, hiHz, nChannels, T);
+        run(name("Lyon", "channels", nChannels), nSamples, nSamples, [&]{
+            for (int i=0; i<nSamples; i++)
+                lyon(xp[i], out);
+        });
+        Cascade cascade(50.0f, hiHz, nChannels, T);
+        run(name("Cascade", "channels", nChannels), nSamples, nSamples, [&]{
+            for (int i=0; i<nSamples; i++)
+                cascade(xp[i], out);
+        });
+        int block = 256;
+        float* bout = new float[block*nChannels];
+        run(name("Lyon/block", "channels", nChannels), nSamples, nSamples,
+            [&]{
+                for (int i=0; i+block<=nSamples; i+=block)
+                    lyon(block, xp+i, bout);
+            }
+        );
+        run(name("Cascade/block", "channels", nChannels), nSamples, nSamples,
+            [&]{
+                for (int i=0; i+block<=nSamples; i+=block)
+                    cascade(block, xp+i, bout);
+            }
+        );
+        delete [] bout;
+
+        // Eight streams at once, each the same signal
+        int nStreams = 8;
+        MultiCascade multi(50.0f, hiHz, nChannels, T);
+        for (int s=0; s<nStreams; s++)
+            multi.add();
+        int nl = multi.lanes();
+        float* min = new float[block*nl];
+        float* mout = new float[block*nChannels*nl];
+        run(name("MultiCascade/8", "channels", nChannels),
+            nSamples*nStreams, nSamples*nStreams, [&]{
+                for (int i=0; i+block<=nSamples; i+=block)
+                {
+                    for (int t=0; t<block; t++)
+                        for (int l=0; l<nl; l++)
+                            min[t*nl+l] = xp[i+t];
+                    multi.process(block, min, mout);
+                }
+            }
+        );
+        delete [] min;
+        delete [] mout;
+    }
+
+    // The whole codec, through the forms that write into the codec's
+    // scratch rather than copying.  After the first encode and decode the
+    // scratch should be sized, so there should be no more scratch
+    // allocations.  That's not to say there are no allocations at all; the
+    // heap count says how many are left per call.
+    ARCodec arcodec(&pcm);
+    var params;
+    var output;
+    arcodec.encode(x, params);
+    arcodec.decode(params, output);
+    long allocs = Scratch::allocs();
+    long heap = sHeapAllocs;
+    arcodec.encode(x, params);
+    long encodeHeap = sHeapAllocs - heap;
+    heap = sHeapAllocs;
+    arcodec.decode(params, output);
+    long decodeHeap = sHeapAllocs - heap;
+    run(name("ARCodec::encode", "rate", (int)rate), nFrames, nSamples, [&]{
+        arcodec.encode(x, params);
+    });
+    run(name("ARCodec::decode", "rate", (int)rate), nFrames, nSamples, [&]{
+        arcodec.decode(params, output);
+    });
+    printf(
+        "Scratch allocations after warm up: %ld\n", Scratch::allocs() - allocs
+    );
+    printf(
+        "Heap allocations per call after warm up: encode %ld, decode %ld\n",
+        encodeHeap, decodeHeap
+    );
+
+    return 0;
+}
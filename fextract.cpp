@@ -0,0 +1,71 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <fstream>
+#include <lube.h>
+#include <lube/config.h>
+#include "ssp/feature.h"
+
+using namespace std;
+using namespace ssp;
+
+int main(int argc, char** argv)
+{
+    // Command line
+    lube::Option opt("fextract: MFCC / PLP / filterbank feature extraction");
+    opt(" <args> should be the input wave and output HTK files respectively");
+    opt('S', "Read input/output file pairs from a script file", "/dev/null");
+    opt('C', "Read configuration file", "/dev/null");
+    opt("Features are configured in the FrontEnd section");
+    opt.parse(argc, argv);
+
+    // Configuration
+    lube::Config cnf;
+    if (opt['C'] != "/dev/null")
+        cnf.configFile(opt['C']);
+
+    // The file pairs come from the script file, then the command line
+    var files;
+    if (opt['S'] != "/dev/null")
+    {
+        ifstream is(opt['S'].str());
+        if (is.fail())
+            throw lube::error("fextract: cannot open script file");
+        string ifile;
+        string ofile;
+        while (is >> ifile >> ofile)
+        {
+            files.push(ifile.c_str());
+            files.push(ofile.c_str());
+        }
+    }
+    var arg = opt.args();
+    if (arg.size() >= 2)
+    {
+        var ofile = arg.pop();
+        var ifile = arg.pop();
+        files.push(ifile);
+        files.push(ofile);
+    }
+    if (files.size() < 2)
+        opt.usage(0);
+
+    // One file at a time, written as soon as it is done
+    PCM pcm;
+    FrontEnd fe(&pcm);
+    for (int i=0; i<files.size(); i+=2)
+    {
+        var a = pcm.read(files[i]);
+        var feat = fe.extract(a);
+        fe.write(files[i+1], feat);
+    }
+
+    // Done
+    return 0;
+}
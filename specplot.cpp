@@ -7,6 +7,7 @@
  *   Phil Garner, August 2014
  */
 
+#include <algorithm>
 #include <lube.h>
 #include "ssp/ssp.h"
 #include "ssp/ar.h"
@@ -21,48 +22,71 @@ int main(int argc, char** argv)
     opt("Waveform file is the first argument");
     opt.parse(argc, argv);
 
-    // Read the waveform from file
+    // Choose the output type
     PCM pcm;
     var arg = opt.args();
     if (arg.size() < 1)
         opt.usage(0);
     var wav = arg[0];
-    var a = pcm.read(wav);
+    ind ti = arg.index("-t");
+    var t = ti ? arg[ti+1] : "spec";
+    if ((t != "spec") && (t != "ar"))
+        opt.usage(1);
 
-    // Frame it
+    // Read the waveform a block at a time.  Each block holds a whole number
+    // of frames, and the padding and overlap make them the frames of the
+    // whole file.
     int frameSize = 256;
     int framePeriod = 128;
-    var f = pcm.frame(a, frameSize, framePeriod);
-
-    // Window the frames
+    int nPerBlock = 256;
+    int overlap = frameSize - framePeriod;
+    PCMReader reader(
+        &pcm, wav, overlap + nPerBlock*framePeriod, overlap, frameSize/2
+    );
+    Frame frame(frameSize, framePeriod, false);
+    int nFrames = Frame(frameSize, framePeriod).frames(reader.samples());
+    int nBins = frameSize/2 + 1;
+    var p = lube::view({nFrames, nBins}, 0.0f);
     var w = nuttall(frameSize);
-    f *= w;
-
-    // Choose the output type
-    ind ti = arg.index("-t");
-    var t = ti ? arg[ti+1] : "spec";
-    var p;
-    if (t == "spec")
+    int order = arorder(pcm.rate());
+    RealDFT dft(frameSize);
+    Autocorrelation ac(order+1);
+    Levinson ar(order);
+    Gain gain(order);
+    Spectrum spec(order, nBins);
+    var b;
+    int row = 0;
+    while (reader.read(b) && (row < nFrames))
     {
-        // Fourier transform
-        lube::DFT dft(frameSize);
-        var s = dft(f);
+        if (b.size() < frameSize)
+            break;
 
-        // Periodogram
-        p = lube::norm(s);
-    }
-    else if (t == "ar")
-    {
-        // LP spectrum
-        int order = arorder(pcm.rate());
-        Autocorrelation ac(frameSize);
-        var af = ac(f);
-        Levinson ar(order);
-        var lf = ar(af);
-        Gain gain(order);
-        var g = gain(af, lf);
-        Spectrum s(order, 129);
-        p = s(lf, g);
+        // Frame and window
+        var f = frame(b);
+        f *= w;
+
+        var s;
+        if (t == "spec")
+        {
+            // Periodogram
+            s = lube::norm(dft(f));
+        }
+        else
+        {
+            // LP spectrum
+            var af = ac(f);
+            var lf = ar(af);
+            var g = gain(af, lf);
+            s = spec(lf, g);
+        }
+
+        // Gather the rows
+        int n = std::min(s.shape(0), nFrames - row);
+        float* ps = s.ptr<float>();
+        float* pp = p.ptr<float>() + row*nBins;
+        for (int i=0; i<n*nBins; i++)
+            pp[i] = ps[i];
+        row += n;
     }
 
     // Plot
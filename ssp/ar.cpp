@@ -8,6 +8,9 @@
  */
 
 #include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include "ar.h"
 
 using namespace ssp;
@@ -22,36 +25,43 @@ int ssp::arorder(var iRate)
 }
 
 
-Levinson::Levinson(int iOrder, var iPrior)
+/**
+ * With iMixed, float input is processed in double.
+ */
+Levinson::Levinson(int iOrder, var iPrior, bool iMixed)
     : ssp::UnaryFunctor(iOrder+1)
 {
     mPrior = iPrior;
+    mMixed = iMixed;
 }
 
 
-template <class T>
-void levinson(int iSize, T iPrior, T* iAC, T* oT)
+/**
+ * Levinson-Durbin on type T, with the recursion itself in type A
+ */
+template <class T, class A>
+void levinson(int iSize, A iPrior, T* iAC, T* oT)
 {
     // Size is order+1
-    T c[iSize];
-    T p[iSize];
-    T* curr = c;
-    T* prev = p;
-    curr[0] = (T)1.0;
-    T error = iAC[0] + iPrior;
+    A c[iSize];
+    A p[iSize];
+    A* curr = c;
+    A* prev = p;
+    curr[0] = (A)1.0;
+    A error = iAC[0] + iPrior;
     for (int i=1; i<iSize; i++)
     {
         // swap current and previous coefficients
-        T* tmp = curr;
+        A* tmp = curr;
         curr = prev;
         prev = tmp;
 
         // Recurse
-        T k = iAC[i];
+        A k = iAC[i];
         for (int j=1; j<i; j++)
             k += prev[j] * iAC[i-j];
         curr[i] = - k / error;
-        error *= (T)1.0 - curr[i]*curr[i];
+        error *= (A)1.0 - curr[i]*curr[i];
         for (int j=1; j<i; j++)
             curr[j] = prev[j] + curr[i] * prev[i-j];
     }
@@ -59,7 +69,7 @@ void levinson(int iSize, T iPrior, T* iAC, T* oT)
     // Copy.  Could get rid of this by checking that order is even and swapping
     // curr/prev otherwise.
     for (int i=0; i<iSize; i++)
-        oT[i] = curr[i];
+        oT[i] = (T)curr[i];
 }
 
 
@@ -70,15 +80,21 @@ void Levinson::vector(
     switch (iVar.atype())
     {
     case lube::TYPE_FLOAT:
-        levinson<float>(mSize, mPrior.cast<float>(),
-                        iVar.ptr<float>(iOffsetI),
-                        oVar.ptr<float>(iOffsetO)
-        );
+        if (mMixed)
+            levinson<float, double>(mSize, mPrior.cast<double>(),
+                                    iVar.ptr<float>(iOffsetI),
+                                    oVar.ptr<float>(iOffsetO)
+            );
+        else
+            levinson<float, float>(mSize, mPrior.cast<float>(),
+                                   iVar.ptr<float>(iOffsetI),
+                                   oVar.ptr<float>(iOffsetO)
+            );
         break;
     case lube::TYPE_DOUBLE:
-        levinson<double>(mSize, mPrior.cast<double>(),
-                        iVar.ptr<double>(iOffsetI),
-                        oVar.ptr<double>(iOffsetO)
+        levinson<double, double>(mSize, mPrior.cast<double>(),
+                                 iVar.ptr<double>(iOffsetI),
+                                 oVar.ptr<double>(iOffsetO)
         );
         break;
     default:
@@ -131,14 +147,31 @@ Spectrum::Spectrum(int iOrder, int iSize)
     // Set state variables
     mOrder = iOrder;
 
-    // Pre-compute the "twiddle" factors; saves a lot of CPU
-    static const float pi = atan(1.0) * 4;
-    mTwiddle = lube::view({mSize, mOrder+1}, lube::cfloat(0.0f,0.0f));
+    // Pre-compute the "twiddle" factors; saves a lot of CPU.  They're double
+    // so as to serve both float and double.
+    static const double pi = atan(1.0) * 4;
+    mTwiddle = lube::view({mSize, mOrder+1}, lube::cdouble(0.0, 0.0));
+    lube::cdouble* t = mTwiddle.ptr<lube::cdouble>();
     for (int i=0; i<mSize; i++)
         for (int j=0; j<mOrder+1; j++)
-            mTwiddle(i,j) =
-                lube::exp(lube::cfloat(0.0,-1.0) * pi *
-                        (float)i * (float)j / (float)mSize);
+            t[i*(mOrder+1)+j] = std::polar(1.0, -pi * i * j / mSize);
+}
+
+template <class T>
+void spectrum(
+    int iSize, int iOrder, const lube::cdouble* iTwiddle,
+    const T* iAR, T iGain, T* oSpec
+)
+{
+    for (int i=0; i<iSize; i++)
+    {
+        const lube::cdouble* t = iTwiddle + i*(iOrder+1);
+        std::complex<T> sm = std::complex<T>(0, 0);
+        for (int j=0; j<iOrder+1; j++)
+            sm += std::complex<T>(t[j]) * iAR[j];
+        T tmp = std::abs(sm);
+        oSpec[i] = iGain / (tmp*tmp);
+    }
 }
 
 void Spectrum::vector(
@@ -147,19 +180,23 @@ void Spectrum::vector(
     var& oVar, ind iOffsetO
 ) const
 {
-    if (!iAR.atype<float>())
-        throw std::runtime_error("Spectrum::vector: floats only!");
-
-    float* a = iAR.ptr<float>(iOffsetAR);
-    float* g = iGain.ptr<float>(iOffsetGain);
-    float* o = oVar.ptr<float>(iOffsetO);
-    for (int i=0; i<mSize; i++)
+    lube::cdouble* t = mTwiddle.ptr<lube::cdouble>();
+    switch (iAR.atype())
     {
-        lube::cfloat sm = lube::cfloat(0.0f,0.0f);
-        for (int j=0; j<mOrder+1; j++)
-            sm += mTwiddle(i,j).get<lube::cfloat>() * a[j];
-        float tmp = std::abs(sm);
-        o[i] = *g / (tmp*tmp);
+    case lube::TYPE_FLOAT:
+        spectrum<float>(
+            mSize, mOrder, t, iAR.ptr<float>(iOffsetAR),
+            *iGain.ptr<float>(iOffsetGain), oVar.ptr<float>(iOffsetO)
+        );
+        break;
+    case lube::TYPE_DOUBLE:
+        spectrum<double>(
+            mSize, mOrder, t, iAR.ptr<double>(iOffsetAR),
+            *iGain.ptr<double>(iOffsetGain), oVar.ptr<double>(iOffsetO)
+        );
+        break;
+    default:
+        throw std::runtime_error("Spectrum::vector: unknown type");
     }
 }
 
@@ -183,18 +220,15 @@ void Resynthesis::vector(var iVar, var& oVar) const
 
 
 /**
- * Convert AR polynomial to LSPs
- *
- * The result includes the values 0 (first) and pi (last).  Of course they are
- * redundant, but this is in the spirit of the first 1 in the polynomial also
- * being redundant.
+ * LSPs as the arguments of the roots of P and Q from lube::roots()
  */
-void ToLSP::vector(var iVar, var& oVar) const
+static void rootsLSP(int iSize, var iVar, var& oVar)
 {
-    int order = mSize-2;
-    var p(mSize, 1.0f);
-    var q(mSize, 1.0f);
-    q[mSize-1] = -1.0f;
+    int order = iSize-2;
+    bool dbl = iVar.atype() == lube::TYPE_DOUBLE;
+    var p = dbl ? var(iSize, 1.0) : var(iSize, 1.0f);
+    var q = dbl ? var(iSize, 1.0) : var(iSize, 1.0f);
+    q[iSize-1] = -1.0f;
     for (int i=0; i<order; i++)
     {
         p[i+1] = iVar(i+1) + iVar(order-i);
@@ -210,68 +244,332 @@ void ToLSP::vector(var iVar, var& oVar) const
     // An antipalindromic polynomial of even degree has -1 and 1 as roots
     // A palindromic polynomial (i.e., P) of odd degree has -1 as a root.
     int j = 0;
-    for (int i=0; i<mSize-1; i++)
+    for (int i=0; i<iSize-1; i++)
     {
         if (lube::imag(qr[i]) >= 0.0f)
             oVar(j++) = qr[i].arg();
         if (lube::imag(pr[i]) >= 0.0f)
             oVar(j++) = pr[i].arg();
     }
-    assert(j == mSize);
+    assert(j == iSize);
 
     // We can't rely on roots() being ordered, but it's helpful to have 0 and
     // pi at the ends.
     lube::sort(oVar, oVar);
 }
 
+/**
+ * Palindromic polynomial iPoly of degree iDegree (or antipalindromic with
+ * iAnti) evaluated on the unit circle at angle 2*theta, less its linear
+ * phase so it's real.  iCos and iSin are the cosine and sine of theta.  The
+ * zeros in (0, pi/2) are those of the polynomial in (0, pi).  The cosines
+ * (or sines) of the multiples of theta go by the Chebyshev recursion.
+ */
+static double circle(
+    const double* iPoly, int iDegree, bool iAnti, double iCos, double iSin
+)
+{
+    int m0 = iDegree % 2;
+    double c2 = 2.0 * (2.0 * iCos * iCos - 1.0);
+    double cur = iAnti ? (m0 ? iSin : 0.0) : (m0 ? iCos : 1.0);
+    double prev = iAnti ? (m0 ? -cur : -2.0 * iSin * iCos)
+                        : (m0 ? cur : 0.5 * c2);
+    int k = (iDegree - m0) / 2;
+    double sum = (m0 ? 2.0 : 1.0) * iPoly[k] * cur;
+    while (k-- > 0)
+    {
+        double next = c2 * cur - prev;
+        prev = cur;
+        cur = next;
+        sum += 2.0 * iPoly[k] * cur;
+    }
+    return sum;
+}
+
+/**
+ * The zero of circle() between angles iLo and iHi, where it has values iFLo
+ * and iFHi, by false position with the Illinois modification
+ */
+static double bisect(
+    const double* iPoly, int iDegree, bool iAnti,
+    double iLo, double iHi, double iFLo, double iFHi
+)
+{
+    int side = 0;
+    double w = iLo;
+    for (int i=0; i<50; i++)
+    {
+        w = (iLo * iFHi - iHi * iFLo) / (iFHi - iFLo);
+        if (iHi - iLo < 1e-12)
+            break;
+        double f = circle(
+            iPoly, iDegree, iAnti, std::cos(w * 0.5), std::sin(w * 0.5)
+        );
+        if (f == 0.0)
+            break;
+        if ((f < 0.0) == (iFLo < 0.0))
+        {
+            iLo = w;
+            iFLo = f;
+            if (side == -1)
+                iFHi *= 0.5;
+            side = -1;
+        }
+        else
+        {
+            iHi = w;
+            iFHi = f;
+            if (side == 1)
+                iFLo *= 0.5;
+            side = 1;
+        }
+    }
+    return w;
+}
+
+/**
+ * LSPs by searching the unit circle for sign changes of P and Q, then
+ * refining each.  There are no temporaries beyond the stack.  Two roots of
+ * the same polynomial within one step of the search would be missed; then it
+ * returns false and the caller falls back on rootsLSP().
+ */
+template <class T>
+static bool toLSP(int iOrder, const T* iAR, T* oLSP)
+{
+    int order = iOrder;
+    int n = order+1;
+    double p[n+1];
+    double q[n+1];
+    p[0] = 1.0;
+    q[0] = 1.0;
+    p[n] = 1.0;
+    q[n] = -1.0;
+    for (int i=0; i<order; i++)
+    {
+        p[i+1] = iAR[i+1] + iAR[order-i];
+        q[i+1] = iAR[i+1] - iAR[order-i];
+    }
+
+    // The grid stops short of 0 and pi, where the trivial roots are.  The
+    // half angles step round by rotation.
+    const double pi = std::atan(1.0) * 4;
+    int nGrid = 16 * (n+1);
+    double step = pi / nGrid;
+    double rc = std::cos(step * 0.5);
+    double rs = std::sin(step * 0.5);
+    double c = std::cos(step * 0.25);
+    double s = std::sin(step * 0.25);
+    double w0 = step * 0.5;
+    double p0 = circle(p, n, false, c, s);
+    double q0 = circle(q, n, true, c, s);
+    int j = 0;
+    oLSP[j++] = 0;
+    for (int i=1; i<nGrid; i++)
+    {
+        double w1 = step * (i + 0.5);
+        double cs = c * rc - s * rs;
+        s = s * rc + c * rs;
+        c = cs;
+        double p1 = circle(p, n, false, c, s);
+        double q1 = circle(q, n, true, c, s);
+        if ((p0 < 0.0) != (p1 < 0.0))
+        {
+            if (j > order)
+                return false;
+            oLSP[j++] = (T)bisect(p, n, false, w0, w1, p0, p1);
+        }
+        if ((q0 < 0.0) != (q1 < 0.0))
+        {
+            if (j > order)
+                return false;
+            oLSP[j++] = (T)bisect(q, n, true, w0, w1, q0, q1);
+        }
+        w0 = w1;
+        p0 = p1;
+        q0 = q1;
+    }
+    if (j != n)
+        return false;
+    oLSP[j] = (T)pi;
+
+    // A root of each in the same step may be out of order
+    std::sort(oLSP+1, oLSP+n);
+    return true;
+}
+
+/**
+ * Convert AR polynomial to LSPs
+ *
+ * The result includes the values 0 (first) and pi (last).  Of course they are
+ * redundant, but this is in the spirit of the first 1 in the polynomial also
+ * being redundant.
+ */
+void ToLSP::vector(var iVar, var& oVar) const
+{
+    bool done = false;
+    switch (iVar.atype())
+    {
+    case lube::TYPE_FLOAT:
+        done = toLSP<float>(mSize-2, iVar.ptr<float>(), oVar.ptr<float>());
+        break;
+    case lube::TYPE_DOUBLE:
+        done = toLSP<double>(
+            mSize-2, iVar.ptr<double>(), oVar.ptr<double>()
+        );
+        break;
+    default:
+        break;
+    }
+    if (!done)
+        rootsLSP(mSize, iVar, oVar);
+}
+
+/**
+ * Multiply polynomial ioPoly of degree ioDegree (in z^-1) by (1 - iRoot z^-1)
+ */
+static void linear(double* ioPoly, int& ioDegree, double iRoot)
+{
+    ioPoly[ioDegree+1] = 0.0;
+    for (int k=ioDegree+1; k>0; k--)
+        ioPoly[k] -= iRoot * ioPoly[k-1];
+    ioDegree++;
+}
+
+/**
+ * Multiply polynomial ioPoly of degree ioDegree (in z^-1) by the real
+ * quadratic of a conjugate pair on the unit circle at angle iAngle, i.e., (1
+ * - 2cos(w) z^-1 + z^-2)
+ */
+static void quadratic(double* ioPoly, int& ioDegree, double iAngle)
+{
+    double c = -2.0 * std::cos(iAngle);
+    ioPoly[ioDegree+1] = 0.0;
+    ioPoly[ioDegree+2] = 0.0;
+    for (int k=ioDegree+2; k>0; k--)
+        ioPoly[k] += c * ioPoly[k-1] + (k > 1 ? ioPoly[k-2] : 0.0);
+    ioDegree += 2;
+}
+
 /**
  * Convert LSPs back to AR polynomials
  *
  * As for ToLSP, assume that the LSPs are redundant in that they contain 0 and
- * pi.
+ * pi.  P and Q are multiplied out directly from their roots in double, so
+ * there are no temporaries beyond the stack.
  */
-void FromLSP::vector(var iVar, var& oVar) const
+template <class T>
+void fromLSP(int iOrder, const T* iLSP, T* oAR)
 {
-    assert(iVar.atype() == lube::TYPE_FLOAT);
-    int order = mSize-1;
-    var s = lube::sin(iVar);
-    var c = lube::cos(iVar);
-    var pr(order+2, lube::cfloat(0.0f,0.0f));
-    var qr(order+2, lube::cfloat(0.0f,0.0f));
-
-    int qi = 0;
-    int pi = 0;
-    bool bq = false;
+    int order = iOrder;
+    double p[order+3];
+    double q[order+3];
+    int np = 0;
+    int nq = 0;
+    p[0] = 1.0;
+    q[0] = 1.0;
 
-    // Start with (the redundant) iVar(0) = 0
-    qr[qi++] = 1.0f;
+    // Start with (the redundant) iLSP[0] = 0, a root of Q at 1
+    linear(q, nq, 1.0);
 
     // The conjugate pairs alternate
+    bool bq = false;
     for (int i=1; i<=order; i++)
     {
-        float cf = c[i].get<float>();
-        float sf = s[i].get<float>();
         if (bq)
-        {
-            qr[qi++] = lube::cfloat(cf,  sf);
-            qr[qi++] = lube::cfloat(cf, -sf);
-        }
+            quadratic(q, nq, iLSP[i]);
         else
-        {
-            pr[pi++] = lube::cfloat(cf,  sf);
-            pr[pi++] = lube::cfloat(cf, -sf);
-        }
+            quadratic(p, np, iLSP[i]);
         bq = !bq;
     }
 
     // The location of the remaining root depends on the order
     if (bq)
-        qr[qi] = -1.0f;
+        linear(q, nq, -1.0);
     else
-        pr[pi] = -1.0f;
-    var p = lube::poly(pr);
-    var q = lube::poly(qr);
-    q += p;
-    lube::real(q, oVar);
-    oVar *= 0.5f;
+        linear(p, np, -1.0);
+    for (int k=np+1; k<=order; k++)
+        p[k] = 0.0;
+    for (int k=nq+1; k<=order; k++)
+        q[k] = 0.0;
+    for (int k=0; k<=order; k++)
+        oAR[k] = (T)(0.5 * (p[k] + q[k]));
+}
+
+void FromLSP::vector(var iVar, var& oVar) const
+{
+    switch (iVar.atype())
+    {
+    case lube::TYPE_FLOAT:
+        fromLSP<float>(mSize-1, iVar.ptr<float>(), oVar.ptr<float>());
+        break;
+    case lube::TYPE_DOUBLE:
+        fromLSP<double>(mSize-1, iVar.ptr<double>(), oVar.ptr<double>());
+        break;
+    default:
+        throw std::runtime_error("FromLSP::vector: unknown type");
+    }
+}
+
+
+/**
+ * Resynthesis without overlap-add
+ *
+ * The input is a continuous excitation, and per-frame LSPs and gains with
+ * frame f centred on sample (f+1)*iPeriod, as for the overlap-add of frames
+ * of 2*iPeriod and for excitation() unframed.  The LSPs (and log gains) are
+ * linearly interpolated to the centre of each sub-frame of iSubFrame
+ * samples; interpolated LSPs are still ordered, so each filter is stable.
+ * One all-pole filter then runs over the whole signal, its coefficients
+ * changing at each sub-frame while its state carries on.
+ */
+var ssp::lspSynthesis(
+    var iExcitation, var iLSP, var iGain, int iPeriod, int iSubFrame
+)
+{
+    int nSamples = iExcitation.size();
+    int nFrames = iLSP.shape(0);
+    int width = iLSP.shape(1);
+    int order = width-2;
+    int nSub = (nSamples + iSubFrame - 1) / iSubFrame;
+
+    // Interpolate to the sub-frame centres
+    var lsp = lube::view({nSub, width}, 0.0f);
+    std::vector<float> gain(nSub);
+    float* il = iLSP.ptr<float>();
+    float* ig = iGain.ptr<float>();
+    float* ol = lsp.ptr<float>();
+    const float gainFloor = 1e-10f;
+    for (int s=0; s<nSub; s++)
+    {
+        float t = (s*iSubFrame + 0.5f*(iSubFrame-1)) / iPeriod - 1.0f;
+        int f0 = std::min(std::max(0, (int)std::floor(t)), nFrames-1);
+        int f1 = std::min(f0+1, nFrames-1);
+        float a = std::min(std::max(t-f0, 0.0f), 1.0f);
+        for (int k=0; k<width; k++)
+            ol[s*width+k] = (1.0f-a) * il[f0*width+k] + a * il[f1*width+k];
+
+        // Digital silence has zero gain, so floor it before the log
+        float g0 = std::log(std::max(ig[f0], gainFloor));
+        float g1 = std::log(std::max(ig[f1], gainFloor));
+        gain[s] = std::exp(0.5f * ((1.0f-a) * g0 + a * g1));
+    }
+    FromLSP fromLSP(order);
+    var ar = fromLSP(lsp);
+
+    // One running filter
+    var ret(nSamples, 0.0f);
+    float* c = ar.ptr<float>();
+    float* e = iExcitation.ptr<float>();
+    float* y = ret.ptr<float>();
+    for (int i=0; i<nSamples; i++)
+    {
+        int s = i / iSubFrame;
+        const float* a = c + s*(order+1);
+        float sum = gain[s] * e[i];
+        int p = std::min(order, i);
+        for (int k=1; k<=p; k++)
+            sum -= a[k] * y[i-k];
+        y[i] = sum;
+    }
+    return ret;
 }
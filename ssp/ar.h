@@ -24,13 +24,14 @@ namespace ssp
     class Levinson : public ssp::UnaryFunctor
     {
     public:
-        Levinson(int iOrder=0, var iPrior=0.0f);
+        Levinson(int iOrder=0, var iPrior=0.0f, bool iMixed=false);
     protected:
         void vector(
             var iVar, ind iOffsetI, var& oVar, ind iOffsetO
         ) const;
     private:
         var mPrior;
+        bool mMixed;
     };
 
     /**
@@ -69,7 +70,8 @@ namespace ssp
     };
 
     /**
-     * Retrieve the excitation
+     * Retrieve the excitation.  Float only, as is Resynthesis; both go
+     * through core::Filter.
      */
     class Excitation : public lube::NaryFunctor
     {
@@ -80,7 +82,7 @@ namespace ssp
     };
 
     /**
-     * Resynthesis
+     * Resynthesis; float only
      */
     class Resynthesis : public lube::NaryFunctor
     {
@@ -90,6 +92,10 @@ namespace ssp
         void vector(var iVar, var& oVar) const;
     };
 
+    var lspSynthesis(
+        var iExcitation, var iLSP, var iGain, int iPeriod, int iSubFrame
+    );
+
     /**
      * Convert AR polynomial to LSPs
      */
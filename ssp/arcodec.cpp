@@ -7,97 +7,460 @@
  *   Phil Garner, May 2015
  */
 
+#include <cmath>
+#include <string>
 #include <lube/module.h>
 
 #include "arcodec.h"
 #include "ar.h"
 #include "pitch.h"
+#include "vad.h"
+#include "htk.h"
+#include "arfile.h"
+#include "quantise.h"
+#include "profile.h"
 
 using namespace ssp;
 
-ARCodec::ARCodec(PCM* iPCM, bool iOracle)
+/**
+ * Files ending in .arc are the single file binary container, and .arb the
+ * quantised bitstream; anything else is the HTK + text triple.
+ */
+static bool hasSuffix(var iFile, const char* iSuffix)
+{
+    std::string f = iFile.str();
+    std::string s = iSuffix;
+    return (f.size() > s.size()) &&
+        (f.compare(f.size()-s.size(), s.size(), s) == 0);
+}
+
+ARCodec::ARCodec(
+    PCM* iPCM, bool iOracle, bool iInterpolate, bool iYIN, bool iVAD
+)
     : Codec(iPCM)
 {
     mOracle = iOracle;
+    mInterpolate = iInterpolate;
+    mYIN = iYIN;
+    mVAD = iVAD;
 }
 
+/*
+ * Scratch slots.  Encode and decode don't share any.
+ */
+enum {
+    SLOT_FRAME,
+    SLOT_AC,
+    SLOT_AR,
+    SLOT_GAIN,
+    SLOT_LSP,
+    SLOT_PITCHFRAME,
+    SLOT_PITCH,
+    SLOT_F0,
+    SLOT_HNR,
+    SLOT_MASK,
+    SLOT_SPEECHAR,
+    SLOT_SPEECHLSP,
+    SLOT_SPEECHPITCHFRAME,
+    SLOT_SPEECHPITCH,
+    SLOT_EXCITATION,
+    SLOT_DECODEAR,
+    SLOT_RESYNTH,
+    SLOT_OUTPUT
+};
+
+/**
+ * Encode a signal, padded at each end.  The parameters are the caller's to
+ * keep.
+ */
 var ARCodec::encode(var iSignal)
+{
+    return encode(iSignal, -1);
+}
+
+/**
+ * Samples between frames
+ */
+int ARCodec::period() const
+{
+    return mPCM->secondsToSamples(0.005, PCM::AT_LEAST);
+}
+
+/**
+ * Context needed either side of a frame centre; half the pitch frame
+ */
+int ARCodec::context() const
+{
+    return mPCM->secondsToSamples(0.025, PCM::AT_LEAST) / 2;
+}
+
+/**
+ * The speech mask of the last encode() with VAD; scratch, as the parameters
+ */
+var ARCodec::mask() const
+{
+    return mMask;
+}
+
+/**
+ * Encode a signal with iContext samples of context at each end, or padded
+ * if iContext is negative.  A signal too short for a single frame gives nil.
+ * The parameters are a copy of the scratch.
+ */
+var ARCodec::encode(var iSignal, int iContext)
+{
+    var params;
+    encode(iSignal, params, iContext);
+    var ret;
+    for (int i=0; i<params.size(); i++)
+        ret[i] = params[i].copy();
+    return ret;
+}
+
+/**
+ * Encode a signal as encode(iSignal, iContext), but into oParams without a
+ * copy.  The intermediate and output arrays are the codec's scratch, so
+ * repeated calls on signals of the same length don't allocate them again.
+ * The flip side is that oParams is overwritten by the next such call.
+ */
+void ARCodec::encode(var iSignal, var& oParams, int iContext)
 {
     // Frame and window.  The window should be asymmetric, so ask for one too
     // long, then pop off the last sample.
-    int framePeriod = mPCM->secondsToSamples(0.005, PCM::AT_LEAST);
+    int framePeriod = period();
     int frameSize = framePeriod * 2;
     int pitchSize = mPCM->secondsToSamples(0.025, PCM::AT_LEAST);
-    Frame frame(frameSize, framePeriod);
-    var f = frame(iSignal);
-    var w = hanning(frameSize+1);
-    w.pop();
-    f *= w;
+    bool pad = (iContext < 0);
+    if (!pad && (iContext < context()))
+        throw lube::error("ARCodec::encode: not enough context");
+    int n = iSignal.size();
+    int nFrames = pad
+        ? n / framePeriod + 1
+        : (n >= iContext*2) ? (n - iContext*2) / framePeriod + 1 : 0;
+    if (nFrames == 0)
+    {
+        oParams = var();
+        return;
+    }
+
+    // Without padding, each framing starts half its frame before the first
+    // centre
+    Frame frame(frameSize, framePeriod, pad);
+    var x = pad ? iSignal : iSignal.view(
+        {(nFrames-1) * framePeriod + frameSize}, iContext - frameSize/2
+    );
+    var f = mScratch.get(SLOT_FRAME, {nFrames, frameSize});
+    SSP_PROFILE_TIME("Frame", frame(x, f));
+    SSP_PROFILE_COUNT("Frame", SAMPLES, iSignal.size());
+    SSP_PROFILE_COUNT("Frame", FRAMES, nFrames);
+    if (mWindow.size() != frameSize)
+    {
+        mWindow = hanning(frameSize+1);
+        mWindow.pop();
+    }
+    SSP_PROFILE_TIME("Window", f *= mWindow);
 
-    // AR analysis
+    // AR analysis.  Float storage, but accumulate the autocorrelation and
+    // recursion in double so high orders stay stable.  Only the lags that
+    // the recursion needs are calculated, so each is normalised over most of
+    // the frame, and lag 0 is the frame energy.
     int order = arorder(mPCM->rate());
-    Autocorrelation acorr(frameSize);
-    Levinson lev(order);
+    Autocorrelation acorr(order+1, true);
+    Levinson lev(order, 0.0f, true);
     Gain gain(order);
     ToLSP toLSP(order);
 
-    var ac = acorr(f);
-    var ar = lev(ac);
-    var gg = gain(ac, ar);
+    var ac = mScratch.get(SLOT_AC, {nFrames, order+1});
+    var ar = mScratch.get(SLOT_AR, {nFrames, order+1});
+    var gg = mScratch.get(SLOT_GAIN, {nFrames});
+    var lsp = mScratch.get(SLOT_LSP, {nFrames, order+2});
+    SSP_PROFILE_TIME("Autocorrelation", acorr(f, ac));
+    SSP_PROFILE_COUNT("Autocorrelation", FRAMES, nFrames);
+    SSP_PROFILE_TIME("Levinson", lev(ac, ar));
+    SSP_PROFILE_COUNT("Levinson", FRAMES, nFrames);
+    SSP_PROFILE_TIME("Gain", gain(ac, ar, gg));
+    SSP_PROFILE_COUNT("Gain", FRAMES, nFrames);
 
-    var ret;
-    ret[0] = toLSP(ar);
-    ret[1] = gg;
+    // Voice activity, holding on for 100ms.  Only the first three lags are
+    // read.
+    int nSpeech = nFrames;
+    if (mVAD)
+    {
+        VAD vad(9.0f, 3.0f, (int)(0.1f * mPCM->rate() / framePeriod));
+        mMask = mScratch.get(SLOT_MASK, {nFrames});
+        SSP_PROFILE_TIME("VAD", vad(ac, mMask));
+        SSP_PROFILE_COUNT("VAD", FRAMES, nFrames);
+        float* m = mMask.ptr<float>();
+        nSpeech = 0;
+        for (int i=0; i<nFrames; i++)
+            if (m[i] > 0.0f)
+                nSpeech++;
+    }
+
+    if (nSpeech == nFrames)
+    {
+        SSP_PROFILE_TIME("ToLSP", toLSP(ar, lsp));
+    }
+    else
+    {
+        // Root finding for the speech only.  The rest get the LSPs of the
+        // flat filter, for which the gain is just the energy.
+        if (nSpeech > 0)
+        {
+            var sar = mScratch.get(SLOT_SPEECHAR, {nSpeech, order+1});
+            var slsp = mScratch.get(SLOT_SPEECHLSP, {nSpeech, order+2});
+            compact(mMask, ar, sar);
+            SSP_PROFILE_TIME("ToLSP", toLSP(sar, slsp));
+            expand(mMask, slsp, lsp);
+        }
+        const float pi = std::atan(1.0f) * 4;
+        float* m = mMask.ptr<float>();
+        float* pa = ac.ptr<float>();
+        float* pl = lsp.ptr<float>();
+        float* pg = gg.ptr<float>();
+        for (int i=0; i<nFrames; i++)
+            if (m[i] == 0.0f)
+            {
+                for (int j=0; j<order+2; j++)
+                    pl[i*(order+2)+j] = pi * j / (order+1);
+                pg[i] = pa[i*(order+1)];
+            }
+    }
+    SSP_PROFILE_COUNT("ToLSP", FRAMES, nSpeech);
+
+    mParams[0] = lsp;
+    mParams[1] = gg;
 
     if (mOracle)
     {
         // Oracle excitation
         Excitation excit;
-        ret[2] = excit({f, ar, gg});
+        var ex = mScratch.get(SLOT_EXCITATION, {nFrames, frameSize});
+        SSP_PROFILE_TIME("Excitation", excit({f, ar, gg}, ex));
+        SSP_PROFILE_COUNT("Excitation", FRAMES, nFrames);
+        mParams[2] = ex;
     }
     else
     {
         // Pitch / HNR excitation
-        Frame pframe(pitchSize, framePeriod);
-        var pf = pframe(iSignal);
-        Pitch pitch(mPCM);
-        var p = pitch(pf);
+        var p = mScratch.get(SLOT_PITCH, {nFrames, 2});
+        if (mYIN)
+        {
+            // PitchYIN pads for itself, so just gets the centres
+            PitchYIN pitch(mPCM, pitchSize, framePeriod);
+            var y = pad ? iSignal : iSignal.view(
+                {(nFrames-1) * framePeriod + 1}, iContext
+            );
+            SSP_PROFILE_TIME("Pitch", pitch(y, p));
+        }
+        else
+        {
+            Frame pframe(pitchSize, framePeriod, pad);
+            var y = pad ? iSignal : iSignal.view(
+                {(nFrames-1) * framePeriod + pitchSize},
+                iContext - pitchSize/2
+            );
+            var pf = mScratch.get(SLOT_PITCHFRAME, {nFrames, pitchSize});
+            SSP_PROFILE_TIME("PitchFrame", pframe(y, pf));
+            SSP_PROFILE_COUNT("PitchFrame", SAMPLES, iSignal.size());
+            SSP_PROFILE_COUNT("PitchFrame", FRAMES, nFrames);
+            Pitch pitch(mPCM);
+            if (nSpeech == nFrames)
+            {
+                SSP_PROFILE_TIME("Pitch", pitch(pf, p));
+            }
+            else if (nSpeech > 0)
+            {
+                var spf = mScratch.get(
+                    SLOT_SPEECHPITCHFRAME, {nSpeech, pitchSize}
+                );
+                var sp = mScratch.get(SLOT_SPEECHPITCH, {nSpeech, 2});
+                compact(mMask, pf, spf);
+                SSP_PROFILE_TIME("Pitch", pitch(spf, sp));
+                expand(mMask, sp, p);
+            }
+        }
+        SSP_PROFILE_COUNT("Pitch", FRAMES, mYIN ? nFrames : nSpeech);
 
         // pitch & hnr should be separate
-        p.transpose();
-        ret[2] = p.subview(1, 0);
-        ret[3] = p.subview(1, ret[2].size());
+        var f0 = mScratch.get(SLOT_F0, {nFrames});
+        var hnr = mScratch.get(SLOT_HNR, {nFrames});
+        float* pp = p.ptr<float>();
+        float* pf0 = f0.ptr<float>();
+        float* phnr = hnr.ptr<float>();
+        for (int i=0; i<nFrames; i++)
+        {
+            pf0[i] = pp[i*2];
+            phnr[i] = pp[i*2+1];
+        }
+
+        // Without speech, the excitation is noise; the pitch just holds,
+        // from the first speech if there's no previous
+        if (nSpeech < nFrames)
+        {
+            float* m = mMask.ptr<float>();
+            float last = 100.0f;
+            for (int i=0; i<nFrames; i++)
+                if (m[i] > 0.0f)
+                {
+                    last = pf0[i];
+                    break;
+                }
+            for (int i=0; i<nFrames; i++)
+            {
+                if (m[i] > 0.0f)
+                    last = pf0[i];
+                else
+                {
+                    pf0[i] = last;
+                    phnr[i] = 0.0f;
+                }
+            }
+        }
+        mParams[2] = f0;
+        mParams[3] = hnr;
     }
 
+    oParams = mParams;
+}
+
+/**
+ * Encode a file a block at a time, gathering the frames into one set of
+ * parameters as encode() of the whole file would give.  The reader must be
+ * set up for context() as described in arcodec.h.
+ */
+var ARCodec::encode(PCMReader& ioReader)
+{
+    int nFrames = ioReader.samples() / period() + 1;
+    var ret;
+    var block;
+    var params;
+    int frame = 0;
+    while (ioReader.read(block))
+    {
+        encode(block, params, context());
+        if (params.size() == 0)
+            continue;
+        int n = params[1].size();
+        if (frame + n > nFrames)
+            throw lube::error("ARCodec::encode: reader blocks don't fit");
+        for (int i=0; i<params.size(); i++)
+        {
+            if (frame == 0)
+            {
+                var sh = params[i].shape();
+                sh[0] = nFrames;
+                ret[i] = lube::view(sh, 0.0f);
+            }
+            int size = params[i].size() / n;
+            float* p = params[i].ptr<float>();
+            float* r = ret[i].ptr<float>() + frame*size;
+            for (int j=0; j<n*size; j++)
+                r[j] = p[j];
+        }
+        frame += n;
+    }
+    if (frame == 0)
+        return var();
+    if (frame != nFrames)
+        throw lube::error("ARCodec::encode: reader blocks don't fit");
     return ret;
 }
 
+/**
+ * Decode parameters to a signal that is the caller's to keep
+ */
 var ARCodec::decode(var iParams)
+{
+    var o;
+    decode(iParams, o);
+    return o.copy();
+}
+
+/**
+ * Decode parameters to a signal as decode(iParams), but without a copy.  As
+ * for encode(), oSignal may be scratch that the next such call overwrites.
+ */
+void ARCodec::decode(var iParams, var& oSignal)
 {
     // Resynthesise using decomposed signals
     int order = arorder(mPCM->rate());
     Resynthesis resynth;
     FromLSP fromLSP(order);
 
-    var ar = fromLSP(iParams[0]);
-    var re;
+    if (mInterpolate && !mOracle)
+    {
+        // Continuous excitation through one interpolated filter
+        int framePeriod = period();
+        int subFrame = mPCM->secondsToSamples(0.001, PCM::EXACT);
+        SSP_PROFILE_TIME(
+            "excitation",
+            var ex = excitation(
+                iParams[2], iParams[3], mPCM, framePeriod, false
+            )
+        );
+        SSP_PROFILE_COUNT("excitation", SAMPLES, ex.size());
+        SSP_PROFILE_TIME(
+            "lspSynthesis",
+            var o = lspSynthesis(
+                ex, iParams[0], iParams[1], framePeriod, subFrame
+            )
+        );
+        SSP_PROFILE_COUNT("lspSynthesis", SAMPLES, o.size());
+        oSignal = o;
+        return;
+    }
+
+    int nFrames = iParams[1].size();
+    var ar = mScratch.get(SLOT_DECODEAR, {nFrames, order+1});
+    SSP_PROFILE_TIME("FromLSP", fromLSP(iParams[0], ar));
+    SSP_PROFILE_COUNT("FromLSP", FRAMES, nFrames);
+    var ex;
     if (mOracle)
-        re = resynth({iParams[2],ar,iParams[1]});
+        ex = iParams[2];
     else
     {
-        var ex = excitation(iParams[2], iParams[3], mPCM);
-        re = resynth({ex, ar, iParams[1]});
+        SSP_PROFILE_TIME(
+            "excitation",
+            ex = excitation(iParams[2], iParams[3], mPCM, period())
+        );
+        SSP_PROFILE_COUNT("excitation", FRAMES, nFrames);
     }
+    int frameSize = ex.shape(1);
+    var re = mScratch.get(SLOT_RESYNTH, {nFrames, frameSize});
+    SSP_PROFILE_TIME("Resynthesis", resynth({ex, ar, iParams[1]}, re));
+    SSP_PROFILE_COUNT("Resynthesis", FRAMES, nFrames);
 
     // Reconstruction using overlap-add
     OverlapAdd ola;
-    var o = ola(re);
+    int nSamples = (nFrames-1) * (frameSize/2) + frameSize;
+    var o = mScratch.get(SLOT_OUTPUT, {nSamples});
+    SSP_PROFILE_TIME("OverlapAdd", ola(re, o));
+    SSP_PROFILE_COUNT("OverlapAdd", FRAMES, nFrames);
+    SSP_PROFILE_COUNT("OverlapAdd", SAMPLES, nSamples);
 
-    return o;
+    oSignal = o;
 }
 
 var ARCodec::read(var iFile)
 {
+    if (hasSuffix(iFile, ".arc"))
+    {
+        ARFile arf;
+        var params = arf.read(iFile);
+        if (arf.info().rate != mPCM->rate())
+            throw lube::error("ARCodec::read: file rate does not match pcm rate");
+        return params;
+    }
+    if (hasSuffix(iFile, ".arb"))
+    {
+        ARQuantiser arq(arorder(mPCM->rate()));
+        var params = arq.read(iFile);
+        if (arq.rate() != mPCM->rate())
+            throw lube::error("ARCodec::read: file rate does not match pcm rate");
+        return params;
+    }
+
     // Begin by reading the HTK file, which is LSPs and log(gg)
     lube::filemodule htkm("htk");
     lube::file& htk = htkm.create();
@@ -142,8 +505,26 @@ var ARCodec::read(var iFile)
 
 void ARCodec::write(var iFile, var iParams)
 {
-    // We need to concatenate the meaningful parts of the LSP and log(gg)
-    // together into one file
+    int framePeriod = mPCM->secondsToSamples(0.005, PCM::AT_LEAST);
+    if (hasSuffix(iFile, ".arc"))
+    {
+        ARFile arf;
+        arf.write(
+            iFile, iParams, mPCM->rate(), mPCM->samplesToSeconds(framePeriod)
+        );
+        return;
+    }
+    if (hasSuffix(iFile, ".arb"))
+    {
+        ARQuantiser arq(arorder(mPCM->rate()));
+        arq.write(
+            iFile, iParams, mPCM->rate(), mPCM->samplesToSeconds(framePeriod)
+        );
+        return;
+    }
+
+    // The meaningful parts of the LSP and log(gg) are concatenated into one
+    // HTK file.  They are gathered frame by frame as the file is written.
     var lsp = iParams[0];
     var lgg = lube::log(iParams[1]);
     var lf0 = lube::log(iParams[2]);
@@ -151,19 +532,13 @@ void ARCodec::write(var iFile, var iParams)
 
     int nFrames = lsp.shape(0);
     int nParams = lsp.shape(1)-1;
-    var prm = lube::view({nFrames, nParams});
-    for (int f=0; f<nFrames; f++)
-    {
-        for (int p=0; p<nParams-1; p++)
-            prm(f, p) = lsp(f, p+1);
-        prm(f, nParams-1) = lgg[f];
-    }
-
-    // Params are HTK format
-    lube::filemodule htkm("htk");
-    lube::file& htk = htkm.create();
-    var prmFile = iFile;
-    htk.write(prmFile, prm);
+    HTKWriter::part part[2] = {
+        {lsp.ptr<float>(1), nParams-1, nParams+1},
+        {lgg.ptr<float>(), 1, 1}
+    };
+    HTKWriter htk(iFile.str(), nParams, 0.01f, HTK_USER, nFrames);
+    htk.write(nFrames, 2, part);
+    htk.close();
 
     // log(f0) and hnr files are text
     lube::filemodule txtm("txt");
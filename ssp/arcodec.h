@@ -16,17 +16,61 @@ namespace ssp
 {
     /**
      * AR codec
+     *
+     * By default, decoding synthesises frame by frame and overlap-adds.
+     * With iInterpolate, the (non-oracle) excitation is continuous and
+     * lspSynthesis() filters it in one pass with interpolated LSPs.
+     * With iYIN, encoding tracks pitch with PitchYIN rather than Pitch.
+     * With iVAD, encoding only finds LSPs and pitch for the frames that VAD
+     * calls speech; the others get a flat spectrum with the frame energy as
+     * gain, and unvoiced excitation at the last pitch.  PitchYIN works on
+     * the signal, so still runs throughout.  mask() is the VAD output of
+     * the last encode().
+     *
+     * Working arrays are kept between calls.  Once the sizes settle, they,
+     * the framing and the LSP search allocate nothing more; the pitch
+     * trackers, the excitation and lube itself still do, and ssp-bench
+     * counts what's left.  encode() and decode() return copies; the forms
+     * with an output argument return the working arrays themselves, so
+     * avoid the copy, but are only valid until the next call of the same.
+     *
+     * encode() with iContext >= context() takes a signal that already has
+     * iContext samples of context at each end, rather than padding it.  The
+     * frames are centred every period() samples from iContext.  Blocks from
+     * PCMReader(pcm, file, context()*2 - period() + n*period(),
+     * context()*2 - period(), context()) then encode to n frames each,
+     * the same frames as encoding the whole file.  encode(PCMReader&) does
+     * just that, gathering the frames of all the blocks.  The LSPs and gains
+     * (and the oracle excitation) are then those of the whole file; the
+     * pitch tracker smooths over each call, so pitch and HNR can differ.
      */
     class ARCodec : public Codec
     {
     public:
-        ARCodec(PCM* iPCM, bool iOracle=false);
+        ARCodec(
+            PCM* iPCM, bool iOracle=false, bool iInterpolate=false,
+            bool iYIN=false, bool iVAD=false
+        );
         virtual var encode(var iSignal);
+        var encode(var iSignal, int iContext);
+        void encode(var iSignal, var& oParams, int iContext=-1);
+        var encode(PCMReader& ioReader);
         virtual var decode(var iParams);
+        void decode(var iParams, var& oSignal);
+        int period() const;
+        int context() const;
+        var mask() const;
         virtual var read(var iFile);
         virtual void write(var iFile, var iParams);
     private:
         bool mOracle;
+        bool mInterpolate;
+        bool mYIN;
+        bool mVAD;
+        Scratch mScratch;
+        var mWindow;
+        var mParams;
+        var mMask;
     };
 }
 
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "arfile.h"
+
+using namespace ssp;
+
+static const char cMagic[4] = {'S', 'S', 'P', 'A'};
+static const int cVersion = 1;
+
+ARFile::ARFile(var iStr)
+    : Config(iStr)
+{
+    mAttr["quantise"] = config("quantise", 0);
+    mHeader = 0;
+    mTable = 0;
+    mData = 0;
+    mSize = 0;
+}
+
+ARFile::~ARFile()
+{
+    close();
+}
+
+/**
+ * Convert the {lsp, gain, f0, hnr} tuple of ARCodec::encode() to a [nFrames,
+ * order+3] matrix of rows: order LSPs (without 0 and pi), log gain, log f0
+ * and HNR.  The oracle codec's {lsp, gain, excitation} has no row form.
+ */
+var ssp::paramsToRows(var iParams)
+{
+    if ((iParams.size() != 4) || (iParams[2].dim() != 1))
+        throw lube::error(
+            "paramsToRows: need {lsp, gain, f0, hnr}; not oracle parameters"
+        );
+    var lsp = iParams[0];
+    int nFrames = lsp.shape(0);
+    int order = lsp.shape(1)-2;
+    int nParams = order+3;
+    var rows = lube::view({nFrames, nParams}, 0.0f);
+    float* row = rows.ptr<float>();
+    float* l = lsp.ptr<float>();
+    float* g = iParams[1].ptr<float>();
+    float* f0 = iParams[2].ptr<float>();
+    float* hnr = iParams[3].ptr<float>();
+    for (int f=0; f<nFrames; f++)
+    {
+        float* r = row + f*nParams;
+        for (int p=0; p<order; p++)
+            r[p] = l[f*(order+2)+p+1];
+        r[order+0] = std::log(g[f]);
+        r[order+1] = std::log(f0[f]);
+        r[order+2] = hnr[f];
+    }
+    return rows;
+}
+
+/**
+ * The inverse of paramsToRows()
+ */
+var ssp::rowsToParams(var iRows)
+{
+    static const float pi = atan(1.0) * 4;
+    int nFrames = iRows.shape(0);
+    int order = iRows.shape(1)-3;
+    var lsp = lube::view({nFrames, order+2}, 0.0f);
+    var gg(nFrames, 0.0f);
+    var f0(nFrames, 0.0f);
+    var hnr(nFrames, 0.0f);
+    float* row = iRows.ptr<float>();
+    float* l = lsp.ptr<float>();
+    float* g = gg.ptr<float>();
+    float* p = f0.ptr<float>();
+    float* h = hnr.ptr<float>();
+    for (int f=0; f<nFrames; f++)
+    {
+        float* r = row + f*(order+3);
+        float* lf = l + f*(order+2);
+        lf[0] = 0.0f;
+        std::memcpy(lf+1, r, order*sizeof(float));
+        lf[order+1] = pi;
+        g[f] = std::exp(r[order+0]);
+        p[f] = std::exp(r[order+1]);
+        h[f] = r[order+2];
+    }
+    return {lsp, gg, f0, hnr};
+}
+
+/**
+ * Write the {lsp, gain, f0, hnr} tuple of ARCodec::encode().  The whole file
+ * is assembled in memory and written at once.
+ */
+void ARFile::write(var iFile, var iParams, float iRate, float iPeriod)
+{
+    var rows = paramsToRows(iParams);
+    int nFrames = rows.shape(0);
+    int nParams = rows.shape(1);
+    int order = nParams-3;
+    bool quantise = mAttr["quantise"].cast<int>();
+    float* row = rows.ptr<float>();
+
+    // The header, then the quantiser table if any, then the rows
+    header h;
+    std::memcpy(h.magic, cMagic, 4);
+    h.version = cVersion;
+    h.order = order;
+    h.nFrames = nFrames;
+    h.rate = iRate;
+    h.period = iPeriod;
+    h.bits = quantise ? 16 : 32;
+    h.offset = sizeof(header) + (quantise ? 2*nParams*sizeof(float) : 0);
+    h.offset = (h.offset + 15) & ~15;
+    long size = h.offset + (long)nFrames * nParams * h.bits/8;
+    char* buf = new char[size];
+    std::memset(buf, 0, h.offset);
+    std::memcpy(buf, &h, sizeof(header));
+    if (quantise)
+    {
+        // Per column offset and step, then round to the nearest step
+        float* table = (float*)(buf + sizeof(header));
+        unsigned short* q = (unsigned short*)(buf + h.offset);
+        for (int p=0; p<nParams; p++)
+        {
+            float lo = nFrames ? row[p] : 0.0f;
+            float hi = lo;
+            for (int f=1; f<nFrames; f++)
+            {
+                lo = std::min(lo, row[f*nParams+p]);
+                hi = std::max(hi, row[f*nParams+p]);
+            }
+            float step = (hi - lo) / 65535;
+            table[p] = lo;
+            table[nParams+p] = step;
+            for (int f=0; f<nFrames; f++)
+                q[f*nParams+p] = (step > 0.0f)
+                    ? (unsigned short)((row[f*nParams+p] - lo) / step + 0.5f)
+                    : 0;
+        }
+    }
+    else
+        std::memcpy(buf + h.offset, row, (long)nFrames*nParams*sizeof(float));
+
+    std::ofstream os(iFile.str(), std::ofstream::out | std::ofstream::binary);
+    if (os.fail())
+    {
+        delete [] buf;
+        throw lube::error("ARFile::write(): Open failed");
+    }
+    os.write(buf, size);
+    delete [] buf;
+    if (os.fail())
+        throw lube::error("ARFile::write(): Write failed");
+}
+
+/**
+ * Map a file into memory and check the header
+ */
+void ARFile::open(var iFile)
+{
+    close();
+    int fd = ::open(iFile.str(), O_RDONLY);
+    if (fd < 0)
+        throw lube::error("ARFile::open(): Open failed");
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw lube::error("ARFile::open(): Stat failed");
+    }
+    mSize = st.st_size;
+    void* map = 0;
+    if (mSize >= (long)sizeof(header))
+        map = mmap(0, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (!map || (map == MAP_FAILED))
+        throw lube::error("ARFile::open(): Map failed");
+    mHeader = (const header*)map;
+    const header& h = *mHeader;
+
+    // The rows must start after the header and any table, aligned, and
+    // end within the file.  The sizes are in long so a silly order or
+    // frame count can't overflow.
+    long nParams = (long)h.order+3;
+    long table = (h.bits == 16) ? 2*nParams*sizeof(float) : 0;
+    if ( std::memcmp(h.magic, cMagic, 4) || (h.version != cVersion) ||
+         (h.order < 0) || (h.nFrames < 0) ||
+         ((h.bits != 16) && (h.bits != 32)) ||
+         (h.offset < (long)sizeof(header) + table) || (h.offset % 4) ||
+         (h.offset > mSize) ||
+         ((long)h.nFrames * nParams > (mSize - h.offset) / (h.bits/8)) )
+    {
+        close();
+        throw lube::error("ARFile::open(): Not a valid file");
+    }
+    mTable = (const float*)((const char*)map + sizeof(header));
+    mData = (const char*)map + h.offset;
+}
+
+void ARFile::close()
+{
+    if (mHeader)
+        munmap((void*)mHeader, mSize);
+    mHeader = 0;
+    mTable = 0;
+    mData = 0;
+    mSize = 0;
+}
+
+/**
+ * Decode one row, i.e., order LSPs, log gain, log f0 and HNR
+ */
+void ARFile::frame(int iFrame, float* oParams) const
+{
+    if (!mHeader || (iFrame < 0) || (iFrame >= mHeader->nFrames))
+        throw lube::error("ARFile::frame(): No such frame");
+    int nParams = mHeader->order+3;
+    if (mHeader->bits == 32)
+    {
+        const float* r = (const float*)mData + (long)iFrame*nParams;
+        std::memcpy(oParams, r, nParams*sizeof(float));
+        return;
+    }
+    const unsigned short* q =
+        (const unsigned short*)mData + (long)iFrame*nParams;
+    for (int p=0; p<nParams; p++)
+        oParams[p] = mTable[p] + mTable[nParams+p] * q[p];
+}
+
+/**
+ * Read a file into the {lsp, gain, f0, hnr} tuple of ARCodec::encode().  The
+ * file stays mapped, so info() remains valid.
+ */
+var ARFile::read(var iFile)
+{
+    open(iFile);
+    int nFrames = mHeader->nFrames;
+    int nParams = mHeader->order+3;
+    var rows = lube::view({nFrames, nParams}, 0.0f);
+    float* r = rows.ptr<float>();
+    for (int f=0; f<nFrames; f++)
+        frame(f, r + f*nParams);
+    return rowsToParams(rows);
+}
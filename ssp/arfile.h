@@ -0,0 +1,61 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef ARFILE_H
+#define ARFILE_H
+
+#include "ssp.h"
+
+namespace ssp
+{
+    var paramsToRows(var iParams);
+    var rowsToParams(var iRows);
+
+    /**
+     * Binary container for AR codec parameters
+     *
+     * One file holds all the streams.  After a fixed header, each frame is
+     * a row of order LSPs (without the redundant 0 and pi), log gain, log
+     * f0 and HNR.  Rows are either floats, or, if "quantise" is set, 16 bit
+     * values with a per-column offset and step stored after the header.
+     * Everything is naturally aligned, so the file can be used in place via
+     * mmap: open() maps it, and frame() decodes one row.
+     */
+    class ARFile : public lube::Config
+    {
+    public:
+        struct header
+        {
+            char magic[4];
+            int version;
+            int order;
+            int nFrames;
+            float rate;
+            float period;
+            int bits;
+            int offset;
+        };
+        ARFile(var iStr="ARFile");
+        ~ARFile();
+        void write(var iFile, var iParams, float iRate, float iPeriod);
+        var read(var iFile);
+        void open(var iFile);
+        void close();
+        const header& info() const { return *mHeader; };
+        void frame(int iFrame, float* oParams) const;
+    private:
+        var mAttr;
+        const header* mHeader;
+        const float* mTable;
+        const char* mData;
+        long mSize;
+    };
+}
+
+#endif // ARFILE_H
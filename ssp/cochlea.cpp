@@ -9,7 +9,13 @@
 
 #include <cmath>
 #include <cassert>
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include "ssp.h"
 #include "cochlea.h"
@@ -20,37 +26,227 @@ using namespace ssp;
 using namespace lube;
 
 
+const int Cochlea::cChunk;
+
 Cochlea::Cochlea()
 {
     mNFilters = 0;
+    mDecimate = 0;
+    mCompress = 1.0f;
+    mEnvFilters = 0;
+    mEnvWindow = 0;
+    mEnvHistory = 0;
+    mEnvChunk = 0;
+    mEnvHead = 0;
+    mEnvCount = 0;
+}
+
+Cochlea::~Cochlea()
+{
+    if (mEnvWindow)
+        delete [] mEnvWindow;
+    if (mEnvHistory)
+        delete [] mEnvHistory;
+    if (mEnvChunk)
+        delete [] mEnvChunk;
+}
+
+/**
+ * Set up the envelope stage; this also resets it.
+ */
+void Cochlea::decimate(int iDecimate, float iCompress)
+{
+    if (iDecimate < 1)
+        throw lube::error("Cochlea::decimate: factor must be positive");
+    mDecimate = iDecimate;
+    mCompress = iCompress;
+    if (mEnvWindow)
+        delete [] mEnvWindow;
+    int taps = mDecimate*2;
+    mEnvWindow = new float[taps];
+    float sum = 0.0f;
+    for (int i=0; i<taps; i++)
+    {
+        mEnvWindow[i] = 0.5f - 0.5f * std::cos(2.0f * PI * (i+0.5f) / taps);
+        sum += mEnvWindow[i];
+    }
+    for (int i=0; i<taps; i++)
+        mEnvWindow[i] /= sum;
+    mEnvFilters = 0;
+    resetEnvelope();
 }
 
+void Cochlea::resetEnvelope()
+{
+    if (mEnvFilters != mNFilters)
+    {
+        if (mEnvHistory)
+            delete [] mEnvHistory;
+        if (mEnvChunk)
+            delete [] mEnvChunk;
+        mEnvFilters = mNFilters;
+        mEnvHistory = new float[mDecimate*2*mNFilters];
+        mEnvChunk = new float[cChunk*mNFilters];
+    }
+    for (int i=0; i<mDecimate*2*mNFilters; i++)
+        mEnvHistory[i] = 0.0f;
+    mEnvHead = 0;
+    mEnvCount = 0;
+}
 
-void Cochlea::set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+/**
+ * Filter, rectify, compress and decimate iNSamples samples.  Returns the
+ * number of envelope frames (of mNFilters) written to oEnvelope; at most
+ * (iNSamples + pending) / iDecimate.  Samples left over count towards the
+ * next call.
+ */
+int Cochlea::envelope(int iNSamples, const float* iSample, float* oEnvelope)
 {
-    // Calculate the centre frequencies equally spaced on ERB rate scale.
-    // minHz and maxHz correspond to the range extremes.
-    mNFilters = iNFilters;
-    const bool mel = 0;
-    float minRate = mel ? hzToMel(iMinHz) : hzToERBRate(iMinHz);
-    float maxRate = mel ? hzToMel(iMaxHz) : hzToERBRate(iMaxHz);
-    float step = (maxRate-minRate)/(mNFilters+1);  // +1 = mNFilters+2 filters
+    if (!mDecimate)
+        throw lube::error("Cochlea::envelope: call decimate() first");
+    if (mEnvFilters != mNFilters)
+        resetEnvelope();
+    int taps = mDecimate*2;
+    int nOut = 0;
+    for (int c=0; c<iNSamples; c+=cChunk)
+    {
+        int n = std::min(cChunk, iNSamples-c);
+        operator ()(n, iSample+c, mEnvChunk);
+        for (int t=0; t<n; t++)
+        {
+            // Hair cell: rectify and compress into the history
+            float* x = mEnvChunk + t*mNFilters;
+            float* h = mEnvHistory + mEnvHead*mNFilters;
+            for (int k=0; k<mNFilters; k++)
+            {
+                float v = std::max(x[k], 0.0f);
+                h[k] = (mCompress == 1.0f) ? v : std::pow(v, mCompress);
+            }
+            mEnvHead = (mEnvHead+1) % taps;
+
+            // Low-pass, but only at the decimated rate
+            if (++mEnvCount < mDecimate)
+                continue;
+            mEnvCount = 0;
+            float* o = oEnvelope + nOut*mNFilters;
+            for (int k=0; k<mNFilters; k++)
+                o[k] = 0.0f;
+            for (int i=0; i<taps; i++)
+            {
+                int j = (mEnvHead-1-i+taps) % taps;
+                float w = mEnvWindow[i];
+                float* hj = mEnvHistory + j*mNFilters;
+                for (int k=0; k<mNFilters; k++)
+                    o[k] += w * hj[k];
+            }
+            nOut++;
+        }
+    }
+    return nOut;
+}
+
 
-    // Go backwards, and include the extremes.  This is so the cascades work.
-    // The simpler filters should ignore indeces that are outside
-    // 0..mNFilters-1.
-    for (int i=mNFilters+1; i>=0; --i)
+/**
+ * The coefficients of a filterbank of this type, from the cache if the same
+ * one has been designed before.  Designs live until the process exits.
+ */
+std::shared_ptr<const CochleaDesign> Cochlea::design(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+) const
+{
+    typedef std::tuple<int, int, float, float, int, float> key;
+    static std::mutex mutex;
+    static std::map<key, std::shared_ptr<const CochleaDesign> > cache;
+    key k(type(), iScale, iMinHz, iMaxHz, iNFilters, iPeriod);
     {
-        float rate = minRate + step*i;
-        float hz = mel ? melToHz(rate) : erbRateToHz(rate);
-        float erb = hzToERB(hz);
-        set(i-1, hz, erb, iPeriod);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(k);
+        if (it != cache.end())
+            return it->second;
     }
 
-    // Zero all the states
+    // Calculate without the lock so other designs aren't held up; if
+    // another thread got there first, theirs is kept
+    std::shared_ptr<const CochleaDesign> d =
+        calculate(iMinHz, iMaxHz, iNFilters, iPeriod, iScale);
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.insert(std::make_pair(k, d)).first->second;
+}
+
+/**
+ * Calculate the coefficients of a filterbank of this type.  The centre
+ * frequencies are equally spaced on the warped scale; minHz and maxHz
+ * correspond to the range extremes, which are not themselves filters.  Each
+ * filter is also passed the one above it, which the cascades use for the
+ * zeros.
+ */
+std::shared_ptr<CochleaDesign> Cochlea::calculate(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+) const
+{
+    if ((iScale < WARP_MEL) || (iScale > WARP_LOG))
+        throw lube::error("Cochlea::design: unknown scale");
+    if ((iScale == WARP_LOG) && (iMinHz <= 0.0f))
+        throw lube::error("Cochlea::design: log scale needs minHz > 0");
+    std::shared_ptr<CochleaDesign> d = std::make_shared<CochleaDesign>();
+    int nc = nCoeffs();
+    d->type = type();
+    d->scale = iScale;
+    d->nFilters = iNFilters;
+    d->nCoeffs = nc;
+    d->centre.resize(iNFilters);
+    d->coeff.resize(iNFilters*nc);
+
+    float minRate = hzToWarp(iScale, iMinHz);
+    float maxRate = hzToWarp(iScale, iMaxHz);
+    float step = (maxRate-minRate)/(iNFilters+1);  // +1 = iNFilters+2 filters
+    float hz[iNFilters+2];
+    float erb[iNFilters+2];
+    for (int i=0; i<iNFilters+2; i++)
+    {
+        hz[i] = warpToHz(iScale, minRate + step*i);
+        erb[i] = hzToERB(hz[i]);
+    }
+    for (int i=0; i<iNFilters; i++)
+    {
+        d->centre[i] = hz[i+1];
+        coeffs(hz[i+1], erb[i+1], hz[i+2], erb[i+2], iPeriod, &d->coeff[i*nc]);
+    }
+    return d;
+}
+
+void Cochlea::set(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+)
+{
+    set(*design(iMinHz, iMaxHz, iNFilters, iPeriod, iScale));
+}
+
+/**
+ * Load a design, which must be for this type of filterbank, and zero the
+ * states.
+ */
+void Cochlea::set(const CochleaDesign& iDesign)
+{
+    if ((iDesign.type != type()) || (iDesign.nCoeffs != nCoeffs()))
+        throw lube::error("Cochlea::set: design is for another filterbank");
+    resize(iDesign.nFilters);
+    mNFilters = iDesign.nFilters;
+    for (int i=0; i<mNFilters; i++)
+        load(i, iDesign.centre[i], &iDesign.coeff[i*iDesign.nCoeffs]);
     reset();
 }
 
+/**
+ * Filter a block of samples into [iNSamples, mNFilters] outputs.  By
+ * default this is just the sample by sample operator() in a loop.
+ */
+void Cochlea::operator ()(int iNSamples, const float* iSample, float* oFilter)
+{
+    for (int t=0; t<iNSamples; t++)
+        operator ()(iSample[t], oFilter + t*mNFilters);
+}
+
 // You'd think there'd be a library function for this
 static int factorial(int iN)
 {
@@ -60,21 +256,14 @@ static int factorial(int iN)
     return ret;
 }
 
+/**
+ * The a_n factor relating the bandwidth of an order n filter to the ERB
+ */
 float Cochlea::bwScale(int iOrder)
 {
-    // This will break if two types of filter use it for different orders in
-    // the same instance
-    static bool init = false;
-    static float a;
-    if (!init)
-    {
-        // Calculate the a_n factor; it's static for a given order
-        float numer = PI * factorial(2*iOrder-2) * std::pow(2.0f,-(2*iOrder-2));
-        float denom = std::pow(factorial(iOrder-1), 2);
-        a = numer / denom;
-        init = true;
-    }
-    return a;
+    float numer = PI * factorial(2*iOrder-2) * std::pow(2.0f,-(2*iOrder-2));
+    float denom = std::pow(factorial(iOrder-1), 2);
+    return numer / denom;
 }
 
 Holdsworth::Holdsworth()
@@ -82,10 +271,18 @@ Holdsworth::Holdsworth()
     mFilter = 0;
 }
 
-Holdsworth::Holdsworth(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+Holdsworth::Holdsworth(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+)
 {
-    mFilter = new filter[iNFilters];
-    Cochlea::set(iMinHz, iMaxHz, iNFilters, iPeriod);
+    mFilter = 0;
+    set(iMinHz, iMaxHz, iNFilters, iPeriod, iScale);
+}
+
+Holdsworth::Holdsworth(const CochleaDesign& iDesign)
+{
+    mFilter = 0;
+    set(iDesign);
 }
 
 Holdsworth::~Holdsworth()
@@ -95,23 +292,35 @@ Holdsworth::~Holdsworth()
     mFilter = 0;
 }
 
-void Holdsworth::set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+void Holdsworth::resize(int iNFilters)
 {
+    if (mFilter && (iNFilters == mNFilters))
+        return;
     if (mFilter)
         delete [] mFilter;
     mFilter = new filter[iNFilters];
-    Cochlea::set(iMinHz, iMaxHz, iNFilters, iPeriod);
 }
 
-void Holdsworth::set(int iFilter, float iHz, float iBW, float iPeriod)
+void Holdsworth::coeffs(
+    float iHz, float iBW, float iZHz, float iZBW, float iPeriod, float* oCoeff
+) const
+{
+    cfloat d = std::exp(cfloat(0.0f, -2.0f*PI*iHz*iPeriod));
+    cfloat u = std::exp(cfloat(0.0f,  2.0f*PI*iHz*iPeriod));
+    oCoeff[0] = 1.0f - std::exp(-2.0f*PI*iBW/bwScale(cOrder)*iPeriod);
+    oCoeff[1] = d.real();
+    oCoeff[2] = d.imag();
+    oCoeff[3] = u.real();
+    oCoeff[4] = u.imag();
+}
+
+void Holdsworth::load(int iFilter, float iCentre, const float* iCoeff)
 {
-    if ((iFilter < 0) || (iFilter >= mNFilters))
-        return;
     filter& f = mFilter[iFilter];
-    f.centre = iHz;
-    f.coeff = 1.0f - std::exp(-2.0f*PI*iBW/bwScale(cOrder)*iPeriod);
-    f.dDelta = std::exp(cfloat(0.0f, -2.0f*PI*iHz*iPeriod));
-    f.uDelta = std::exp(cfloat(0.0f,  2.0f*PI*iHz*iPeriod));
+    f.centre = iCentre;
+    f.coeff = iCoeff[0];
+    f.dDelta = cfloat(iCoeff[1], iCoeff[2]);
+    f.uDelta = cfloat(iCoeff[3], iCoeff[4]);
     f.dShift = 1.0f;
     f.uShift = 1.0f;
 }
@@ -164,12 +373,23 @@ void Holdsworth::operator ()(float iSample, float* oFilter)
 Lyon::Lyon()
 {
     mFilter = 0;
+    mNThreads = 1;
 }
 
-Lyon::Lyon(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+Lyon::Lyon(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+)
 {
-    mFilter = new filter[iNFilters];
-    Cochlea::set(iMinHz, iMaxHz, iNFilters, iPeriod);
+    mNThreads = 1;
+    mFilter = 0;
+    set(iMinHz, iMaxHz, iNFilters, iPeriod, iScale);
+}
+
+Lyon::Lyon(const CochleaDesign& iDesign)
+{
+    mNThreads = 1;
+    mFilter = 0;
+    set(iDesign);
 }
 
 Lyon::~Lyon()
@@ -179,25 +399,32 @@ Lyon::~Lyon()
     mFilter = 0;
 }
 
-void Lyon::set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+void Lyon::resize(int iNFilters)
 {
+    if (mFilter && (iNFilters == mNFilters))
+        return;
     if (mFilter)
         delete [] mFilter;
     mFilter = new filter[iNFilters];
-    Cochlea::set(iMinHz, iMaxHz, iNFilters, iPeriod);
 }
 
-void Lyon::set(int iFilter, float iHz, float iBW, float iPeriod)
+void Lyon::coeffs(
+    float iHz, float iBW, float iZHz, float iZBW, float iPeriod, float* oCoeff
+) const
 {
-    if ((iFilter < 0) || (iFilter >= mNFilters))
-        return;
-    filter& f = mFilter[iFilter];
-    f.centre = iHz;
     float E = std::exp(-2.0f*PI*iBW/bwScale(cOrder)*iPeriod);
     float C = std::cos( 2.0f*PI*iHz*iPeriod);
-    f.coeff[0] = 1.0f - E*C*2 + E*E;
-    f.coeff[1] = E*C*2;
-    f.coeff[2] = -E*E;
+    oCoeff[0] = 1.0f - E*C*2 + E*E;
+    oCoeff[1] = E*C*2;
+    oCoeff[2] = -E*E;
+}
+
+void Lyon::load(int iFilter, float iCentre, const float* iCoeff)
+{
+    filter& f = mFilter[iFilter];
+    f.centre = iCentre;
+    for (int i=0; i<3; i++)
+        f.coeff[i] = iCoeff[i];
 }
 
 void Lyon::reset()
@@ -227,13 +454,13 @@ void Lyon::operator ()(float iSample, float* oFilter)
         float z = iSample;
         float w;
         filter& f = mFilter[i];
-        for (int i=1; i<cOrder+1; i++)
+        for (int j=1; j<cOrder+1; j++)
         {
-            w = f.coeff[0] * f.state[0][i-1] +
-                f.coeff[1] * f.state[0][i] +
-                f.coeff[2] * f.state[1][i];
-            f.state[1][i-1] = f.state[0][i-1];
-            f.state[0][i-1] = z;
+            w = f.coeff[0] * f.state[0][j-1] +
+                f.coeff[1] * f.state[0][j] +
+                f.coeff[2] * f.state[1][j];
+            f.state[1][j-1] = f.state[0][j-1];
+            f.state[0][j-1] = z;
             z = w;
         }
         f.state[1][cOrder] = f.state[0][cOrder];
@@ -242,16 +469,98 @@ void Lyon::operator ()(float iSample, float* oFilter)
     }
 }
 
+void Lyon::operator ()(int iNSamples, const float* iSample, float* oFilter)
+{
+    int nGroups = std::max(1, std::min(mNThreads, mNFilters));
+    std::vector<std::thread> worker;
+    for (int g=1; g<nGroups; g++)
+        worker.push_back(std::thread(
+            &Lyon::block, this,
+            g*mNFilters/nGroups, (g+1)*mNFilters/nGroups,
+            iNSamples, iSample, oFilter
+        ));
+    block(0, mNFilters/nGroups, iNSamples, iSample, oFilter);
+    for (size_t w=0; w<worker.size(); w++)
+        worker[w].join();
+}
+
+/**
+ * Filter channels [iLo, iHi) of a block.  This is the same recursion as the
+ * sample by sample operator(), written out for the two sections; each
+ * section's output depends on its input one sample back, so the sections of
+ * a channel don't depend on each other within a sample.
+ */
+void Lyon::block(
+    int iLo, int iHi, int iNSamples, const float* iSample, float* oFilter
+)
+{
+    int n = iHi - iLo;
+    if (n < 1)
+        return;
+    float c0[n], c1[n], c2[n];
+    float y1p[n], y1pp[n], y2p[n], y2pp[n];
+    for (int k=0; k<n; k++)
+    {
+        filter& f = mFilter[iLo+k];
+        c0[k] = f.coeff[0];
+        c1[k] = f.coeff[1];
+        c2[k] = f.coeff[2];
+        y1p[k]  = f.state[0][1];
+        y1pp[k] = f.state[1][1];
+        y2p[k]  = f.state[0][2];
+        y2pp[k] = f.state[1][2];
+    }
+
+    // The input history is the same for all channels
+    float xp = mFilter[iLo].state[0][0];
+    float xpp = mFilter[iLo].state[1][0];
+    for (int t=0; t<iNSamples; t++)
+    {
+        float* o = oFilter + t*mNFilters + iLo;
+        for (int k=0; k<n; k++)
+        {
+            float w1 = c0[k] * xp + c1[k] * y1p[k] + c2[k] * y1pp[k];
+            float w2 = c0[k] * y1p[k] + c1[k] * y2p[k] + c2[k] * y2pp[k];
+            y1pp[k] = y1p[k];
+            y1p[k] = w1;
+            y2pp[k] = y2p[k];
+            y2p[k] = w2;
+            o[k] = w2;
+        }
+        xpp = xp;
+        xp = iSample[t];
+    }
+
+    for (int k=0; k<n; k++)
+    {
+        filter& f = mFilter[iLo+k];
+        f.state[0][0] = xp;
+        f.state[1][0] = xpp;
+        f.state[0][1] = y1p[k];
+        f.state[1][1] = y1pp[k];
+        f.state[0][2] = y2p[k];
+        f.state[1][2] = y2pp[k];
+    }
+}
+
 
 Cascade::Cascade()
 {
     mFilter = 0;
 }
 
-Cascade::Cascade(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+Cascade::Cascade(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+)
 {
-    mFilter = new filter[iNFilters];
-    Cochlea::set(iMinHz, iMaxHz, iNFilters, iPeriod);
+    mFilter = 0;
+    set(iMinHz, iMaxHz, iNFilters, iPeriod, iScale);
+}
+
+Cascade::Cascade(const CochleaDesign& iDesign)
+{
+    mFilter = 0;
+    set(iDesign);
 }
 
 Cascade::~Cascade()
@@ -261,43 +570,51 @@ Cascade::~Cascade()
     mFilter = 0;
 }
 
-void Cascade::set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod)
+void Cascade::resize(int iNFilters)
 {
+    if (mFilter && (iNFilters == mNFilters))
+        return;
     if (mFilter)
         delete [] mFilter;
     mFilter = new filter[iNFilters];
-    Cochlea::set(iMinHz, iMaxHz, iNFilters, iPeriod);
 }
 
-void Cascade::set(int iFilter, float iHz, float iBW, float iPeriod)
+/**
+ * The poles are at the given frequency, and the zeros at the poles of the
+ * filter above.  The coefficients are stored as the block version uses
+ * them: the numerator, then the negated denominator without the leading 1.
+ */
+void Cascade::coeffs(
+    float iHz, float iBW, float iZHz, float iZBW, float iPeriod, float* oCoeff
+) const
 {
-    static float zHz = 0.0f;
-    static float zBW = 0.0f;
-    if ((iFilter < 0) || (iFilter >= mNFilters))
-    {
-        zHz = iHz;
-        zBW = iBW;
-        return;
-    }
-    filter& f = mFilter[iFilter];
-    f.centre = iHz;
     float Ep = std::exp(-2.0f*PI*iBW/bwScale(1)*iPeriod);
     float Cp = std::cos(2.0f*PI*iHz*iPeriod);
-    float Ez = std::exp(-2.0f*PI*zBW/bwScale(1)*iPeriod);
-    float Cz = std::cos(2.0f*PI*zHz*iPeriod);
-    float numer[3];
-    float denom[3];
+    float Ez = std::exp(-2.0f*PI*iZBW/bwScale(1)*iPeriod);
+    float Cz = std::cos(2.0f*PI*iZHz*iPeriod);
     float A = ( (1.0f - Ep*Cp*2 + Ep*Ep) /
                 (1.0f - Ez*Cz*2 + Ez*Ez) );
-    numer[0] =  A;
-    numer[1] = -A*Ez*Cz*2;
-    numer[2] =  A*Ez*Ez;
-    denom[0] =  1.0f;
-    denom[1] = -Ep*Cp*2;
-    denom[2] =  Ep*Ep;
+    oCoeff[0] =  A;
+    oCoeff[1] = -A*Ez*Cz*2;
+    oCoeff[2] =  A*Ez*Ez;
+    oCoeff[3] =  Ep*Cp*2;
+    oCoeff[4] = -Ep*Ep;
+}
+
+void Cascade::load(int iFilter, float iCentre, const float* iCoeff)
+{
+    filter& f = mFilter[iFilter];
+    f.centre = iCentre;
+    float numer[3];
+    float denom[3];
+    for (int i=0; i<3; i++)
+        numer[i] = f.numer[i] = iCoeff[i];
+    denom[0] = 1.0f;
+    denom[1] = -iCoeff[3];
+    denom[2] = -iCoeff[4];
     f.filter.set(3, numer, 3, denom);
-    zHz = iHz;
-    zBW = iBW;
+    f.denom[0] = iCoeff[3];
+    f.denom[1] = iCoeff[4];
 }
 
 void Cascade::reset()
@@ -324,3 +641,268 @@ void Cascade::operator ()(float iSample, float* oFilter)
     for (int i=mNFilters-2; i>=0; --i)
         oFilter[i] = mFilter[i].filter(oFilter[i+1], mFilter[i].state);
 }
+
+void Cascade::operator ()(int iNSamples, const float* iSample, float* oFilter)
+{
+    // Structure of arrays copies of the coefficients and states
+    int n = mNFilters;
+    float b0[n], b1[n], b2[n], a1[n], a2[n];
+    float s0[n], s1[n], s2[n];
+    float in[n], out[n];
+    for (int k=0; k<n; k++)
+    {
+        filter& f = mFilter[k];
+        b0[k] = f.numer[0];
+        b1[k] = f.numer[1];
+        b2[k] = f.numer[2];
+        a1[k] = f.denom[0];
+        a2[k] = f.denom[1];
+        s0[k] = f.state[0];
+        s1[k] = f.state[1];
+        s2[k] = f.state[2];
+    }
+
+    // At step s, channel k does sample s-(n-1-k).  Its input is what
+    // channel k+1 output at the previous step, or the signal for the top
+    // channel.  The arithmetic is in the same order as core::Filter.
+    for (int s=0; s<iNSamples+n-1; s++)
+    {
+        int lo = std::max(0, n-1-s);
+        int hi = std::min(n-1, n-2-s+iNSamples);
+        if (s < iNSamples)
+            in[n-1] = iSample[s];
+        for (int k=lo; k<=hi; k++)
+        {
+            float y = in[k] + (a1[k]*s0[k] + a2[k]*s1[k]);
+            s2[k] = s1[k];
+            s1[k] = s0[k];
+            s0[k] = y;
+            out[k] = b0[k]*s0[k] + b1[k]*s1[k] + b2[k]*s2[k];
+        }
+        for (int k=lo; k<=hi; k++)
+            oFilter[(s-(n-1-k))*n + k] = out[k];
+        for (int k=std::max(lo, 1); k<=hi; k++)
+            in[k-1] = out[k];
+    }
+
+    for (int k=0; k<n; k++)
+    {
+        filter& f = mFilter[k];
+        f.state[0] = s0[k];
+        f.state[1] = s1[k];
+        f.state[2] = s2[k];
+    }
+}
+
+
+int core::Lanes::add()
+{
+    for (int i=0; i<size(); i++)
+        if (!mActive[i])
+        {
+            mActive[i] = true;
+            return i;
+        }
+    mActive.push_back(true);
+    return size()-1;
+}
+
+void core::Lanes::remove(int iLane)
+{
+    if ((iLane < 0) || (iLane >= size()) || !mActive[iLane])
+        throw lube::error("Lanes::remove: not an active lane");
+    mActive[iLane] = false;
+}
+
+/*
+ * Lanes are allocated in multiples of this, so the loops over lanes are a
+ * whole number of SIMD registers.
+ */
+static const int cLaneBlock = 8;
+
+MultiLyon::MultiLyon(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+)
+    : Lyon(iMinHz, iMaxHz, iNFilters, iPeriod, iScale)
+{
+    mCapacity = 0;
+}
+
+MultiLyon::MultiLyon(const CochleaDesign& iDesign)
+    : Lyon(iDesign)
+{
+    mCapacity = 0;
+}
+
+/**
+ * Resize the states to iCapacity lanes, keeping those of the existing lanes
+ */
+void MultiLyon::grow(int iCapacity)
+{
+    std::vector<float> x(2*iCapacity, 0.0f);
+    std::vector<float> y(4*mNFilters*iCapacity, 0.0f);
+    for (int l=0; l<mCapacity; l++)
+    {
+        for (int j=0; j<2; j++)
+            x[j*iCapacity+l] = mX[j*mCapacity+l];
+        for (int j=0; j<4*mNFilters; j++)
+            y[j*iCapacity+l] = mY[j*mCapacity+l];
+    }
+    mX.swap(x);
+    mY.swap(y);
+    mCapacity = iCapacity;
+}
+
+int MultiLyon::add()
+{
+    int lane = mLanes.add();
+    if (lane >= mCapacity)
+        grow(mCapacity + cLaneBlock);
+    for (int j=0; j<2; j++)
+        mX[j*mCapacity+lane] = 0.0f;
+    for (int j=0; j<4*mNFilters; j++)
+        mY[j*mCapacity+lane] = 0.0f;
+    return lane;
+}
+
+void MultiLyon::remove(int iStream)
+{
+    mLanes.remove(iStream);
+}
+
+void MultiLyon::process(int iNSamples, const float* iSample, float* oFilter)
+{
+    // The states of Lyon::filter, each [channel][lane]
+    int nl = mCapacity;
+    int nc = mNFilters;
+    float* xp = &mX[0];
+    float* y1p = &mY[0];
+    float* y1pp = y1p + nc*nl;
+    float* y2p = y1pp + nc*nl;
+    float* y2pp = y2p + nc*nl;
+    for (int t=0; t<iNSamples; t++)
+    {
+        for (int c=0; c<nc; c++)
+        {
+            const float* k = mFilter[c].coeff;
+            float* o = oFilter + (t*nc + c)*nl;
+            int s = c*nl;
+            for (int l=0; l<nl; l++)
+            {
+                float w1 =
+                    k[0] * xp[l] + k[1] * y1p[s+l] + k[2] * y1pp[s+l];
+                float w2 =
+                    k[0] * y1p[s+l] + k[1] * y2p[s+l] + k[2] * y2pp[s+l];
+                y1pp[s+l] = y1p[s+l];
+                y1p[s+l] = w1;
+                y2pp[s+l] = y2p[s+l];
+                y2p[s+l] = w2;
+                o[l] = w2;
+            }
+        }
+        const float* x = iSample + t*nl;
+        for (int l=0; l<nl; l++)
+            xp[l] = x[l];
+    }
+}
+
+MultiCascade::MultiCascade(
+    float iMinHz, float iMaxHz, int iNFilters, float iPeriod, int iScale
+)
+    : Cascade(iMinHz, iMaxHz, iNFilters, iPeriod, iScale)
+{
+    mCapacity = 0;
+}
+
+MultiCascade::MultiCascade(const CochleaDesign& iDesign)
+    : Cascade(iDesign)
+{
+    mCapacity = 0;
+}
+
+void MultiCascade::grow(int iCapacity)
+{
+    std::vector<float> s(3*mNFilters*iCapacity, 0.0f);
+    for (int l=0; l<mCapacity; l++)
+        for (int j=0; j<3*mNFilters; j++)
+            s[j*iCapacity+l] = mS[j*mCapacity+l];
+    mS.swap(s);
+    mCapacity = iCapacity;
+}
+
+int MultiCascade::add()
+{
+    int lane = mLanes.add();
+    if (lane >= mCapacity)
+        grow(mCapacity + cLaneBlock);
+    for (int j=0; j<3*mNFilters; j++)
+        mS[j*mCapacity+lane] = 0.0f;
+    return lane;
+}
+
+void MultiCascade::remove(int iStream)
+{
+    mLanes.remove(iStream);
+}
+
+void MultiCascade::process(int iNSamples, const float* iSample, float* oFilter)
+{
+    int nl = mCapacity;
+    int nc = mNFilters;
+    float* s0 = &mS[0];
+    float* s1 = s0 + nc*nl;
+    float* s2 = s1 + nc*nl;
+    for (int t=0; t<iNSamples; t++)
+    {
+        // Top channel down, as the sample by sample Cascade
+        for (int c=nc-1; c>=0; --c)
+        {
+            const filter& f = mFilter[c];
+            const float* in = (c == nc-1)
+                ? iSample + t*nl
+                : oFilter + (t*nc + c+1)*nl;
+            float* o = oFilter + (t*nc + c)*nl;
+            int s = c*nl;
+            for (int l=0; l<nl; l++)
+            {
+                float y = in[l] + (f.denom[0]*s0[s+l] + f.denom[1]*s1[s+l]);
+                s2[s+l] = s1[s+l];
+                s1[s+l] = s0[s+l];
+                s0[s+l] = y;
+                o[l] = f.numer[0]*s0[s+l] + f.numer[1]*s1[s+l] +
+                    f.numer[2]*s2[s+l];
+            }
+        }
+    }
+}
+
+CochleaConfig::CochleaConfig(PCM* iPCM, var iStr)
+    : Config(iStr)
+{
+    mPCM = iPCM;
+    mAttr["type"] = config("type", "cascade");
+    mAttr["scale"] = config("scale", "erb");
+    mAttr["loHz"] = config("loHz", 100.0f);
+    mAttr["hiHz"] = config("hiHz", 0.0f);
+    mAttr["nFilters"] = config("nFilters", 32);
+}
+
+Cochlea* CochleaConfig::create()
+{
+    int scale = warpScale(mAttr["scale"].str());
+    if (scale < 0)
+        throw lube::error("CochleaConfig: unknown scale");
+    float period = 1.0f / mPCM->rate();
+    float loHz = mAttr["loHz"].cast<float>();
+    float hiHz = mAttr["hiHz"].cast<float>();
+    if (hiHz <= 0.0f)
+        hiHz = mPCM->rate() / 2;
+    int nFilters = mAttr["nFilters"].cast<int>();
+    if (mAttr["type"] == "holdsworth")
+        return new Holdsworth(loHz, hiHz, nFilters, period, scale);
+    if (mAttr["type"] == "lyon")
+        return new Lyon(loHz, hiHz, nFilters, period, scale);
+    if (mAttr["type"] == "cascade")
+        return new Cascade(loHz, hiHz, nFilters, period, scale);
+    throw lube::error("CochleaConfig: unknown type");
+}
@@ -10,27 +10,105 @@
 #ifndef COCHLEA_H
 #define COCHLEA_H
 
+#include <memory>
+#include <vector>
 #include <lube.h>
+#include "ssp.h"
 #include "filter.h"
+#include "warp.h"
 
 namespace ssp
 {
+    /**
+     * Filterbank types, for telling designs apart
+     */
+    enum {
+        COCHLEA_HOLDSWORTH,
+        COCHLEA_LYON,
+        COCHLEA_CASCADE
+    };
+
+    /**
+     * The coefficients of a filterbank, precomputed by Cochlea::design().
+     * A design holds no state so it can be shared, between threads too, by
+     * any number of filterbanks of the same type.
+     */
+    struct CochleaDesign
+    {
+        int type;
+        int scale;
+        int nFilters;
+        int nCoeffs;
+        std::vector<float> centre;
+        std::vector<float> coeff;
+    };
+
     /**
      * Model of a human cochlea; in particular the concept of a filterbank.
+     *
+     * envelope() is an optional hair cell stage on top of the filterbank:
+     * half-wave rectification, power law compression (by iCompress) and a
+     * low-pass filter decimating by iDecimate.  The filter is a Hanning
+     * window of 2*iDecimate taps evaluated only at the output instants,
+     * i.e., just the one polyphase branch.  The input goes through the block
+     * operator() a chunk at a time, so only [nSamples/iDecimate, nFilters]
+     * envelope values are ever written out.
+     *
+     * Setting up a filterbank is in two parts: design() calculates the
+     * coefficients, and set() loads them, so one design can be shared by
+     * many filterbanks.  The only shared state is a cache of designs on
+     * (type, scale, range, nFilters, period), guarded by a mutex, so
+     * constructing the same filterbank again just loads the coefficients.
+     * The centre frequencies are equally spaced on the given WARP_ scale.
      */
     class Cochlea
     {
     public:
         Cochlea();
-        virtual ~Cochlea() {};
-        void set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
+        virtual ~Cochlea();
+        std::shared_ptr<const CochleaDesign> design(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        ) const;
+        void set(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        );
+        void set(const CochleaDesign& iDesign);
+        virtual int type() const = 0;
         virtual void operator ()(float iSample, float* oFilter) = 0;
+        virtual void operator ()(
+            int iNSamples, const float* iSample, float* oFilter
+        );
         virtual void reset() = 0;
         virtual void dump() = 0;
+        void decimate(int iDecimate, float iCompress=0.3f);
+        int envelope(int iNSamples, const float* iSample, float* oEnvelope);
     protected:
-        virtual void set(int iFilter, float iHz, float iBW, float iPeriod) = 0;
-        float bwScale(int iOrder);
+        virtual int nCoeffs() const = 0;
+        virtual void coeffs(
+            float iHz, float iBW, float iZHz, float iZBW, float iPeriod,
+            float* oCoeff
+        ) const = 0;
+        virtual void resize(int iNFilters) = 0;
+        virtual void load(int iFilter, float iCentre, const float* iCoeff) = 0;
+        static float bwScale(int iOrder);
         int mNFilters;
+    private:
+        std::shared_ptr<CochleaDesign> calculate(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale
+        ) const;
+        static const int cChunk = 64;
+        void resetEnvelope();
+        int mDecimate;
+        float mCompress;
+        int mEnvFilters;
+        float* mEnvWindow;
+        float* mEnvHistory;
+        float* mEnvChunk;
+        int mEnvHead;
+        int mEnvCount;
     };
 
     /**
@@ -40,14 +118,25 @@ namespace ssp
     {
     public:
         Holdsworth();
-        Holdsworth(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
+        Holdsworth(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        );
+        Holdsworth(const CochleaDesign& iDesign);
         ~Holdsworth();
-        void set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
+        int type() const { return COCHLEA_HOLDSWORTH; };
         void reset();
         void dump();
+        using Cochlea::operator ();
         void operator ()(float iSample, float* oFilter);
     protected:
-        void set(int iFilter, float iHz, float iBW, float iPeriod);
+        int nCoeffs() const { return 5; };
+        void coeffs(
+            float iHz, float iBW, float iZHz, float iZBW, float iPeriod,
+            float* oCoeff
+        ) const;
+        void resize(int iNFilters);
+        void load(int iFilter, float iCentre, const float* iCoeff);
     private:
         static const int cOrder = 4;
         struct filter
@@ -65,20 +154,36 @@ namespace ssp
 
     /**
      * The all-pole (non-)gamma-tone filterbank of Lyon.
+     *
+     * The block operator() gives the same output as the sample by sample
+     * one, but keeps the biquad states in structure-of-arrays form so each
+     * sample is a vectorisable loop over channels.  The channels are
+     * independent, so with threads() > 1 groups of them run in parallel.
      */
     class Lyon : public Cochlea
     {
     public:
         Lyon();
         ~Lyon();
-        Lyon(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
-        void set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
+        Lyon(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        );
+        Lyon(const CochleaDesign& iDesign);
+        int type() const { return COCHLEA_LYON; };
         void reset();
         void dump();
+        void threads(int iNThreads) { mNThreads = iNThreads; };
         void operator ()(float iSample, float* oFilter);
+        void operator ()(int iNSamples, const float* iSample, float* oFilter);
     protected:
-        void set(int iFilter, float iHz, float iBW, float iPeriod);
-    private:
+        int nCoeffs() const { return 3; };
+        void coeffs(
+            float iHz, float iBW, float iZHz, float iZBW, float iPeriod,
+            float* oCoeff
+        ) const;
+        void resize(int iNFilters);
+        void load(int iFilter, float iCentre, const float* iCoeff);
         static const int cOrder = 2;
         struct filter
         {
@@ -87,32 +192,144 @@ namespace ssp
             float state[2][cOrder+1];
         };
         filter* mFilter;
+    private:
+        void block(
+            int iLo, int iHi, int iNSamples,
+            const float* iSample, float* oFilter
+        );
+        int mNThreads;
     };
 
     /**
      * Lyon's two-pole two-zero cascade filterbank.
+     *
+     * The block operator() gives the same output as the sample by sample
+     * one, but runs the channels as a wavefront: channel k filters sample t
+     * while the channel below it filters sample t-1, so at each step the
+     * channels are independent and the inner loop can vectorise.
      */
     class Cascade : public Cochlea
     {
     public:
         Cascade();
         ~Cascade();
-        Cascade(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
-        void set(float iMinHz, float iMaxHz, int iNFilters, float iPeriod);
+        Cascade(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        );
+        Cascade(const CochleaDesign& iDesign);
+        int type() const { return COCHLEA_CASCADE; };
         void reset();
         void dump();
         void operator ()(float iSample, float* oFilter);
+        void operator ()(int iNSamples, const float* iSample, float* oFilter);
     protected:
-        void set(int iFilter, float iHz, float iBW, float iPeriod);
-    private:
+        int nCoeffs() const { return 5; };
+        void coeffs(
+            float iHz, float iBW, float iZHz, float iZBW, float iPeriod,
+            float* oCoeff
+        ) const;
+        void resize(int iNFilters);
+        void load(int iFilter, float iCentre, const float* iCoeff);
         struct filter
         {
             float centre;
             core::Filter filter;
+            float numer[3];
+            float denom[2];
             float state[3];
         };
         filter* mFilter;
     };
+
+    namespace core
+    {
+        /**
+         * Book keeping for multi-stream filterbanks.  A stream joins with
+         * add(), which returns the lane it occupies until remove().  Free
+         * lanes are reused; otherwise the number of lanes grows.
+         */
+        class Lanes
+        {
+        public:
+            int add();
+            void remove(int iLane);
+            int size() const { return (int)mActive.size(); };
+            bool active(int iLane) const { return mActive[iLane]; };
+        private:
+            std::vector<bool> mActive;
+        };
+    }
+
+    /**
+     * Lyon filterbank for many independent streams.  The coefficients are
+     * those of the Lyon base; the states are stored [state][channel][lane],
+     * so each channel of each sample is a vectorisable loop over streams.
+     *
+     * process() takes [nSamples, lanes()] input and gives [nSamples,
+     * nFilters, lanes()] output, lanes() being the capacity.  Inactive
+     * lanes are computed too, but their states are cleared when a stream
+     * is added, so the input there doesn't matter.
+     */
+    class MultiLyon : public Lyon
+    {
+    public:
+        MultiLyon(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        );
+        MultiLyon(const CochleaDesign& iDesign);
+        int add();
+        void remove(int iStream);
+        int lanes() const { return mCapacity; };
+        void process(int iNSamples, const float* iSample, float* oFilter);
+    private:
+        void grow(int iCapacity);
+        core::Lanes mLanes;
+        int mCapacity;
+        std::vector<float> mX;
+        std::vector<float> mY;
+    };
+
+    /**
+     * Cascade filterbank for many independent streams; as MultiLyon.  The
+     * cascade dependency is across channels, so the loop over streams is
+     * still independent.
+     */
+    class MultiCascade : public Cascade
+    {
+    public:
+        MultiCascade(
+            float iMinHz, float iMaxHz, int iNFilters, float iPeriod,
+            int iScale=WARP_ERB
+        );
+        MultiCascade(const CochleaDesign& iDesign);
+        int add();
+        void remove(int iStream);
+        int lanes() const { return mCapacity; };
+        void process(int iNSamples, const float* iSample, float* oFilter);
+    private:
+        void grow(int iCapacity);
+        core::Lanes mLanes;
+        int mCapacity;
+        std::vector<float> mS;
+    };
+
+    /**
+     * A filterbank from configuration: type ("holdsworth", "lyon" or
+     * "cascade"), scale (as warpScale()), loHz, hiHz (0 for Nyquist) and
+     * nFilters, at the sample rate of the PCM.  create() returns a new
+     * filterbank, which the caller should delete.
+     */
+    class CochleaConfig : public lube::Config
+    {
+    public:
+        CochleaConfig(PCM* iPCM, var iStr="Cochlea");
+        Cochlea* create();
+    private:
+        PCM* mPCM;
+        var mAttr;
+    };
 }
 
 #endif // COCHLEA_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <algorithm>
+#include <lube/c++blas.h>
+#include "delta.h"
+
+using namespace ssp::core;
+
+Delta::Delta(int iNParams, int iWindow)
+{
+    mNParams = iNParams;
+    mWindow = iWindow;
+    float norm = 0.0f;
+    for (int k=1; k<=mWindow; k++)
+        norm += 2*k*k;
+    mScale = 1.0f / norm;
+    mBuffer.resize((2*mWindow+1) * mNParams);
+    mNFrames = 0;
+}
+
+/**
+ * Forget the stream; the next push() starts a new one
+ */
+void Delta::reset()
+{
+    mNFrames = 0;
+}
+
+/**
+ * The delta of one frame, given pointers to the 2W+1 frames centred on it
+ */
+void Delta::delta(const float** iFrame, float* oDelta) const
+{
+    const float** f = iFrame + mWindow;
+    for (int p=0; p<mNParams; p++)
+        oDelta[p] = 0.0f;
+    for (int k=1; k<=mWindow; k++)
+    {
+        const float* a = f[k];
+        const float* b = f[-k];
+        for (int p=0; p<mNParams; p++)
+            oDelta[p] += k * (a[p] - b[p]);
+    }
+    for (int p=0; p<mNParams; p++)
+        oDelta[p] *= mScale;
+}
+
+/**
+ * Deltas of a whole [iNFrames, mNParams] matrix
+ */
+void Delta::operator()(int iNFrames, const float* iFrame, float* oDelta)
+    const
+{
+    const float* f[2*mWindow+1];
+    for (int t=0; t<iNFrames; t++)
+    {
+        for (int j=0; j<2*mWindow+1; j++)
+        {
+            int r = std::min(std::max(t-mWindow+j, 0), iNFrames-1);
+            f[j] = iFrame + r*mNParams;
+        }
+        delta(f, oDelta + t*mNParams);
+    }
+}
+
+/**
+ * The ring buffer holds frames iFrame-2W..iFrame by absolute index.  Negative
+ * indices are the replicated first frame.
+ */
+void Delta::store(long iFrame, const float* iData)
+{
+    int size = 2*mWindow+1;
+    blas::copy(mNParams, iData, &mBuffer[(iFrame % size)*mNParams]);
+}
+
+const float* Delta::stored(long iFrame) const
+{
+    int size = 2*mWindow+1;
+    return &mBuffer[(std::max(iFrame, 0L) % size)*mNParams];
+}
+
+/**
+ * Push iNFrames frames of the stream.  Writes the deltas that are now
+ * complete, i.e., for frames up to W behind the latest, to oDelta and
+ * returns how many there were; at most iNFrames.
+ */
+int Delta::push(int iNFrames, const float* iFrame, float* oDelta)
+{
+    int nOut = 0;
+    const float* f[2*mWindow+1];
+    for (int i=0; i<iNFrames; i++)
+    {
+        store(mNFrames, iFrame + i*mNParams);
+        long t = mNFrames - mWindow;
+        mNFrames++;
+        if (t < 0)
+            continue;
+        for (int j=0; j<2*mWindow+1; j++)
+            f[j] = stored(t-mWindow+j);
+        delta(f, oDelta + nOut*mNParams);
+        nOut++;
+    }
+    return nOut;
+}
+
+/**
+ * End of stream: write the outstanding deltas (at most W) by replicating the
+ * last frame, and return how many there were.  The stream is then reset.
+ */
+int Delta::flush(float* oDelta)
+{
+    int nOut = 0;
+    long last = mNFrames-1;
+    const float* f[2*mWindow+1];
+    for (long t=std::max(last-mWindow+1, 0L); t<=last; t++)
+    {
+        for (int j=0; j<2*mWindow+1; j++)
+            f[j] = stored(std::min(t-mWindow+j, last));
+        delta(f, oDelta + nOut*mNParams);
+        nOut++;
+    }
+    reset();
+    return nOut;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <vector>
+
+namespace ssp
+{
+    namespace core
+    {
+        /**
+         * Regression (delta) coefficients over frames of iNParams values.
+         *
+         * The whole-matrix operator() makes one pass over the frames; the
+         * inner loops run along the parameter dimension.  push() and flush()
+         * do the same thing on a stream of frames of any chunk size, with a
+         * look-ahead of iWindow frames.  In both cases the first and last
+         * frames are replicated at the ends.
+         */
+        class Delta
+        {
+        public:
+            Delta(int iNParams, int iWindow=2);
+            void operator()(int iNFrames, const float* iFrame, float* oDelta)
+                const;
+            int push(int iNFrames, const float* iFrame, float* oDelta);
+            int flush(float* oDelta);
+            void reset();
+            int lookahead() const { return mWindow; };
+        private:
+            void delta(const float** iFrame, float* oDelta) const;
+            void store(long iFrame, const float* iData);
+            const float* stored(long iFrame) const;
+            int mNParams;
+            int mWindow;
+            float mScale;
+            std::vector<float> mBuffer;
+            long mNFrames;
+        };
+    }
+}
+
+#endif // DELTA_H
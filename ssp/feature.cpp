@@ -0,0 +1,530 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <lube/module.h>
+
+#include "feature.h"
+#include "ar.h"
+#include "window.h"
+#include "htk.h"
+#include "delta.h"
+#include "vad.h"
+
+using namespace ssp;
+
+/**
+ * Construct the filterbank.  The filter edges are equally spaced on the
+ * warped scale between iLoHz and iHiHz; iHiHz of zero means the Nyquist
+ * frequency, and anything above Nyquist is an error.  Each triangle is unity
+ * at its centre and falls to zero at the centres of its neighbours.
+ */
+FilterbankFeatures::FilterbankFeatures(
+    PCM* iPCM, int iNFilters, int iNBins,
+    float iLoHz, float iHiHz, int iScale, bool iLog
+)
+    : ssp::UnaryFunctor(iNFilters)
+{
+    if (iNBins < 2)
+        throw lube::error("FilterbankFeatures: too few bins");
+    mNBins = iNBins;
+    mScale = iScale;
+    mLog = iLog;
+    float nyquist = iPCM->rate() / 2;
+    if (iHiHz <= 0.0f)
+        iHiHz = nyquist;
+    if ((iLoHz < 0.0f) || (iLoHz >= iHiHz) || (iHiHz > nyquist))
+        throw lube::error("FilterbankFeatures: bad band edges");
+    float lo = hzToWarp(iScale, iLoHz);
+    float hi = hzToWarp(iScale, iHiHz);
+    float step = (hi-lo) / (mSize+1);
+    mLo = lo;
+    mStep = step;
+
+    // Warped frequency of each bin
+    float wBin[mNBins];
+    for (int k=0; k<mNBins; k++)
+        wBin[k] = hzToWarp(iScale, nyquist * k / (mNBins-1));
+
+    // Find the run of bins under each triangle.  The bins are monotonic, so
+    // each run is contiguous; the total is at most about twice the bins.
+    mBand.resize(mSize);
+    int nWeights = 0;
+    for (int m=0; m<mSize; m++)
+    {
+        float l = lo + step*m;
+        float r = l + step*2;
+        int k = 0;
+        while ((k < mNBins) && (wBin[k] <= l))
+            k++;
+        mBand[m].bin = k;
+        while ((k < mNBins) && (wBin[k] < r))
+            k++;
+        mBand[m].size = k - mBand[m].bin;
+        nWeights += mBand[m].size;
+    }
+
+    // Pack the weights
+    mWeight.resize(nWeights);
+    int w = 0;
+    for (int m=0; m<mSize; m++)
+    {
+        float c = lo + step*(m+1);
+        mBand[m].weight = w;
+        for (int j=0; j<mBand[m].size; j++)
+        {
+            float d = std::abs(wBin[mBand[m].bin+j] - c) / step;
+            mWeight[w++] = 1.0f - d;
+        }
+    }
+}
+
+/**
+ * The HTK parameter kind corresponding to the output
+ */
+int FilterbankFeatures::kind() const
+{
+    return mLog ? HTK_FBANK : HTK_MELSPEC;
+}
+
+/**
+ * Centre frequency of the given filter in Hz
+ */
+float FilterbankFeatures::centre(int iFilter) const
+{
+    return warpToHz(mScale, mLo + mStep*(iFilter+1));
+}
+
+void FilterbankFeatures::vector(
+    var iVar, ind iOffsetI, var& oVar, ind iOffsetO
+) const
+{
+    if (iVar.shape(iVar.dim()-1) != mNBins)
+        throw lube::error("FilterbankFeatures: wrong number of bins");
+    const float floor = 1e-8f;
+    float* iv = iVar.ptr<float>(iOffsetI);
+    float* ov = oVar.ptr<float>(iOffsetO);
+    for (int m=0; m<mSize; m++)
+    {
+        const band& b = mBand[m];
+        const float* p = iv + b.bin;
+        const float* w = &mWeight[b.weight];
+        float sum = 0.0f;
+        for (int j=0; j<b.size; j++)
+            sum += w[j] * p[j];
+        ov[m] = mLog ? std::log(std::max(sum, floor)) : sum;
+    }
+}
+
+void LogEnergy::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
+{
+    const float floor = 1e-8f;
+    int n = iVar.shape(iVar.dim()-1);
+    float* iv = iVar.ptr<float>(iOffsetI);
+    float sum = 0.0f;
+    for (int i=0; i<n; i++)
+        sum += iv[i] * iv[i];
+    *oVar.ptr<float>(iOffsetO) = std::log(std::max(sum, floor));
+}
+
+
+/**
+ * Cepstral liftering weight, as HTK's CEPLIFTER
+ */
+static float lifter(int iN, float iLifter)
+{
+    if (iLifter <= 0.0f)
+        return 1.0f;
+    return 1.0f + iLifter / 2 * std::sin(PI * iN / iLifter);
+}
+
+DCT::DCT(int iNCeps, int iNFilters, float iLifter)
+    : ssp::UnaryFunctor(iNCeps)
+{
+    mNFilters = iNFilters;
+    mMatrix.resize(mSize*mNFilters);
+    float scale = std::sqrt(2.0f / mNFilters);
+    for (int i=0; i<mSize; i++)
+        for (int j=0; j<mNFilters; j++)
+            mMatrix[i*mNFilters+j] =
+                scale * lifter(i+1, iLifter) *
+                std::cos(PI * (i+1) * (j+0.5f) / mNFilters);
+}
+
+void DCT::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
+{
+    if (iVar.shape(iVar.dim()-1) != mNFilters)
+        throw lube::error("DCT: wrong number of filters");
+    float* iv = iVar.ptr<float>(iOffsetI);
+    float* ov = oVar.ptr<float>(iOffsetO);
+    for (int i=0; i<mSize; i++)
+    {
+        const float* m = &mMatrix[i*mNFilters];
+        float sum = 0.0f;
+        for (int j=0; j<mNFilters; j++)
+            sum += m[j] * iv[j];
+        ov[i] = sum;
+    }
+}
+
+
+/**
+ * The auditory spectrum is extended by one point at each end (copies of the
+ * extreme filters) so that it spans DC to Nyquist.  The inverse DFT of that
+ * real, even spectrum is then a cosine transform.
+ */
+PerceptualAC::PerceptualAC(
+    const FilterbankFeatures& iFB, int iNFilters, int iOrder
+)
+    : ssp::UnaryFunctor(iOrder+1)
+{
+    mNFilters = iNFilters;
+
+    // Equal loudness curve at the filter centres
+    mLoudness.resize(mNFilters);
+    for (int j=0; j<mNFilters; j++)
+    {
+        float fsq = iFB.centre(j);
+        fsq *= fsq;
+        float fsub = fsq / (fsq + 1.6e5f);
+        mLoudness[j] = fsub * fsub * (fsq + 1.44e6f) / (fsq + 9.61e6f);
+    }
+
+    // Cosine transform over the extended spectrum, including the end weights
+    int m = mNFilters+1;
+    mCosine.resize(mSize*(m+1));
+    for (int k=0; k<mSize; k++)
+        for (int j=0; j<=m; j++)
+        {
+            float w = ((j == 0) || (j == m)) ? 0.5f : 1.0f;
+            mCosine[k*(m+1)+j] = w * std::cos(PI * k * j / m) / m;
+        }
+}
+
+void PerceptualAC::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
+{
+    if (iVar.shape(iVar.dim()-1) != mNFilters)
+        throw lube::error("PerceptualAC: wrong number of filters");
+    float* iv = iVar.ptr<float>(iOffsetI);
+    float* ov = oVar.ptr<float>(iOffsetO);
+
+    // Equal loudness and cube root compression into the extended spectrum
+    int m = mNFilters+1;
+    float a[m+1];
+    for (int j=0; j<mNFilters; j++)
+        a[j+1] = std::cbrt(iv[j] * mLoudness[j]);
+    a[0] = a[1];
+    a[m] = a[m-1];
+
+    for (int k=0; k<mSize; k++)
+    {
+        const float* c = &mCosine[k*(m+1)];
+        float sum = 0.0f;
+        for (int j=0; j<=m; j++)
+            sum += c[j] * a[j];
+        ov[k] = sum;
+    }
+}
+
+
+ARCepstrum::ARCepstrum(int iNCeps, int iOrder, float iLifter)
+    : ssp::UnaryFunctor(iNCeps)
+{
+    mOrder = iOrder;
+    mLifter = iLifter;
+}
+
+/**
+ * The usual recursion for the cepstrum of 1/A(z), where A(z) = 1 + a1 z^-1 +
+ * ... and a_n = 0 beyond the order.
+ */
+void ARCepstrum::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
+{
+    float* a = iVar.ptr<float>(iOffsetI);
+    float* ov = oVar.ptr<float>(iOffsetO);
+    float c[mSize+1];
+    for (int n=1; n<=mSize; n++)
+    {
+        float sum = (n <= mOrder) ? a[n] : 0.0f;
+        for (int k=std::max(1, n-mOrder); k<n; k++)
+            sum += (float)k / n * c[k] * a[n-k];
+        c[n] = -sum;
+    }
+    for (int n=1; n<=mSize; n++)
+        ov[n-1] = c[n] * lifter(n, mLifter);
+}
+
+
+Delta::Delta(int iWindow)
+{
+    mDim = 2;
+    mWindow = iWindow;
+}
+
+void Delta::vector(var iVar, var& oVar) const
+{
+    int nFrames = iVar.shape(0);
+    int nParams = iVar.shape(1);
+    core::Delta delta(nParams, mWindow);
+    delta(nFrames, iVar.ptr<float>(), oVar.ptr<float>());
+}
+
+
+/**
+ * Copy the columns of iVar into oVar starting at the given column
+ */
+static void paste(var iVar, var& oVar, int iColumn)
+{
+    int nFrames = iVar.shape(0);
+    int nIn = iVar.shape(1);
+    int nOut = oVar.shape(1);
+    float* iv = iVar.ptr<float>();
+    float* ov = oVar.ptr<float>();
+    for (int t=0; t<nFrames; t++)
+        for (int p=0; p<nIn; p++)
+            ov[t*nOut + iColumn + p] = iv[t*nIn + p];
+}
+
+/**
+ * Append deltas, and optionally accelerations, to a [nFrames, nParams]
+ * matrix of static features.  The HTK kind is updated to match, so the
+ * result can go straight to the htk module.
+ */
+var ssp::appendDeltas(var iStatic, int& ioKind, int iWindow, bool iAccel)
+{
+    int nFrames = iStatic.shape(0);
+    int nStatic = iStatic.shape(1);
+    int nBlocks = iAccel ? 3 : 2;
+    var ret = lube::view({nFrames, nStatic*nBlocks}, 0.0f);
+    paste(iStatic, ret, 0);
+    Delta delta(iWindow);
+    var d = delta(iStatic);
+    paste(d, ret, nStatic);
+    ioKind |= HTK_D;
+    if (iAccel)
+    {
+        paste(delta(d), ret, nStatic*2);
+        ioKind |= HTK_A;
+    }
+    return ret;
+}
+
+FrontEnd::FrontEnd(PCM* iPCM, var iStr)
+    : Config(iStr)
+{
+    mPCM = iPCM;
+    mAttr["kind"] = config("kind", "MFCC");
+    mAttr["scale"] = config("scale", "mel");
+    mAttr["framePeriod"] = config("framePeriod", 0.01f);
+    mAttr["frameSize"] = config("frameSize", 0.025f);
+    mAttr["preemph"] = config("preemph", 0.97f);
+    mAttr["loHz"] = config("loHz", 0.0f);
+    mAttr["hiHz"] = config("hiHz", 0.0f);
+    mAttr["nFilters"] = config("nFilters", 26);
+    mAttr["nCeps"] = config("nCeps", 12);
+    mAttr["order"] = config("order", 12);
+    mAttr["lifter"] = config("lifter", 22.0f);
+    mAttr["energy"] = config("energy", 1);
+    mAttr["delta"] = config("delta", 0);
+    mAttr["accel"] = config("accel", 0);
+    mAttr["deltaWindow"] = config("deltaWindow", 2);
+    mAttr["vad"] = config("vad", 0);
+}
+
+/**
+ * HTK parameter kind of the features that extract() produces
+ */
+int FrontEnd::kind()
+{
+    int k;
+    if (mAttr["kind"] == "MFCC")
+        k = HTK_MFCC;
+    else if (mAttr["kind"] == "PLP")
+        k = HTK_PLP;
+    else if (mAttr["kind"] == "FBANK")
+        k = HTK_FBANK;
+    else
+        throw lube::error("FrontEnd: unknown kind");
+    if (mAttr["energy"])
+        k |= HTK_E;
+    if (mAttr["delta"] || mAttr["accel"])
+        k |= HTK_D;
+    if (mAttr["accel"])
+        k |= HTK_A;
+    return k;
+}
+
+/**
+ * Frame period in seconds, as realised in samples
+ */
+float FrontEnd::period()
+{
+    return mPCM->samplesToSeconds(
+        mPCM->secondsToSamples(mAttr["framePeriod"], PCM::EXACT)
+    );
+}
+
+var FrontEnd::extract(var iSignal)
+{
+    int k = kind();
+    // The frames are exactly as configured; only the DFT is rounded up to a
+    // power of two, by zero padding.
+    int framePeriod =
+        mPCM->secondsToSamples(mAttr["framePeriod"], PCM::EXACT);
+    int frameSize = mPCM->secondsToSamples(mAttr["frameSize"], PCM::EXACT);
+    int dftSize = 1;
+    while (dftSize < frameSize)
+        dftSize <<= 1;
+    int nBins = dftSize/2 + 1;
+    int nFilters = mAttr["nFilters"].cast<int>();
+    int nCeps = mAttr["nCeps"].cast<int>();
+    float lifter = mAttr["lifter"].cast<float>();
+    int scale = warpScale(mAttr["scale"].str());
+    if (scale < 0)
+        throw lube::error("FrontEnd: unknown scale");
+
+    // Pre-emphasis, framing, energy, window, periodogram
+    var s = iSignal;
+    float preemph = mAttr["preemph"].cast<float>();
+    if (preemph > 0.0f)
+    {
+        var b = {1.0f, -preemph};
+        Filter pe(b);
+        s = pe(iSignal);
+    }
+    Frame frame(frameSize, framePeriod);
+    var f = frame(s);
+    LogEnergy energy;
+    var e = energy(f);
+    Hamming w(frameSize);
+    f *= var(w);
+
+    // Drop the frames that aren't speech before the spectral analysis.  The
+    // deltas are of the whole stream, so the frames that they reach either
+    // side of the speech are analysed too, and dropped after.
+    int nFull = f.shape(0);
+    int nSpeech = nFull;
+    int deltaWindow = mAttr["deltaWindow"].cast<int>();
+    var mask;
+    var need;
+    if (mAttr["vad"])
+    {
+        Autocorrelation acorr(3);
+        VAD vad(9.0f, 3.0f, (int)(0.1f * mPCM->rate() / framePeriod));
+        mask = vad(acorr(f));
+        float* pm = mask.ptr<float>();
+        nSpeech = 0;
+        for (int i=0; i<nFull; i++)
+            if (pm[i] > 0.0f)
+                nSpeech++;
+        if (nSpeech == 0)
+            return var();
+        need = mask;
+        if (k & HTK_D)
+        {
+            int reach = deltaWindow * ((k & HTK_A) ? 2 : 1);
+            need = lube::view({nFull}, 0.0f);
+            float* pd = need.ptr<float>();
+            for (int i=0; i<nFull; i++)
+                if (pm[i] > 0.0f)
+                    for (int j=std::max(0, i-reach);
+                         j<=std::min(nFull-1, i+reach); j++)
+                        pd[j] = 1.0f;
+        }
+        float* pn = need.ptr<float>();
+        int nNeed = 0;
+        for (int i=0; i<nFull; i++)
+            if (pn[i] > 0.0f)
+                nNeed++;
+        var sf = lube::view({nNeed, frameSize}, 0.0f);
+        var se = lube::view({nNeed, 1}, 0.0f);
+        compact(need, f, sf);
+        compact(need, e, se);
+        f = sf;
+        e = se;
+    }
+    var zf = lube::view({f.shape(0), dftSize}, 0.0f);
+    paste(f, zf, 0);
+    RealDFT dft(dftSize);
+    var p = lube::norm(dft(zf));
+
+    // Static features
+    var st;
+    switch (k & 077)
+    {
+    case HTK_MFCC:
+    {
+        FilterbankFeatures fb(
+            mPCM, nFilters, nBins,
+            mAttr["loHz"].cast<float>(), mAttr["hiHz"].cast<float>(), scale
+        );
+        DCT dct(nCeps, nFilters, lifter);
+        st = dct(fb(p));
+        break;
+    }
+    case HTK_PLP:
+    {
+        int order = mAttr["order"].cast<int>();
+        FilterbankFeatures fb(
+            mPCM, nFilters, nBins,
+            mAttr["loHz"].cast<float>(), mAttr["hiHz"].cast<float>(),
+            scale, false
+        );
+        PerceptualAC pac(fb, nFilters, order);
+        Levinson lev(order);
+        ARCepstrum cep(nCeps, order, lifter);
+        st = cep(lev(pac(fb(p))));
+        break;
+    }
+    case HTK_FBANK:
+    {
+        FilterbankFeatures fb(
+            mPCM, nFilters, nBins,
+            mAttr["loHz"].cast<float>(), mAttr["hiHz"].cast<float>(), scale
+        );
+        st = fb(p);
+        break;
+    }
+    }
+
+    // Statics and energy, then the dynamic features of both
+    int nFrames = st.shape(0);
+    int nStatic = st.shape(1) + ((k & HTK_E) ? 1 : 0);
+    var base = lube::view({nFrames, nStatic}, 0.0f);
+    paste(st, base, 0);
+    if (k & HTK_E)
+        paste(e, base, nStatic-1);
+    if (!(k & HTK_D))
+        return base;
+    if (!mAttr["vad"])
+        return appendDeltas(base, k, deltaWindow, k & HTK_A);
+
+    // The dynamic features over the whole stream, then just the speech
+    var full = lube::view({nFull, nStatic}, 0.0f);
+    expand(need, base, full);
+    var d = appendDeltas(full, k, deltaWindow, k & HTK_A);
+    var ret = lube::view({nSpeech, d.shape(1)}, 0.0f);
+    compact(mask, d, ret);
+    return ret;
+}
+
+/**
+ * Write features as an HTK file with the right kind and period
+ */
+void FrontEnd::write(var iFile, var iFeatures)
+{
+    var attr;
+    attr["kind"] = kind();
+    attr["period"] = period();
+    lube::filemodule htkm("htk");
+    lube::file& htk = htkm.create(attr);
+    htk.write(iFile, iFeatures);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef FEATURE_H
+#define FEATURE_H
+
+#include <vector>
+
+#include "ssp.h"
+#include "warp.h"
+
+namespace ssp
+{
+    /**
+     * Triangular filterbank on a warped (mel or ERB) frequency scale.
+     *
+     * The input is a power spectrum of iNBins bins, i.e., DFT size / 2 + 1;
+     * the output is one energy per filter.  Each triangle only covers a short
+     * contiguous run of bins, so rather than a dense [nFilters, nBins]
+     * matrix, only the non-zero run of each band is stored.  The weights of
+     * all the bands are packed end to end in one array.
+     */
+    class FilterbankFeatures : public ssp::UnaryFunctor
+    {
+    public:
+        FilterbankFeatures(
+            PCM* iPCM, int iNFilters, int iNBins,
+            float iLoHz=0.0f, float iHiHz=0.0f,
+            int iScale=WARP_MEL, bool iLog=true
+        );
+        int kind() const;
+        float centre(int iFilter) const;
+    protected:
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    private:
+        struct band
+        {
+            int bin;
+            int size;
+            int weight;
+        };
+        int mNBins;
+        int mScale;
+        float mLo;
+        float mStep;
+        bool mLog;
+        std::vector<band> mBand;
+        std::vector<float> mWeight;
+    };
+
+    /**
+     * Log frame energy, as used for the HTK _E qualifier
+     */
+    class LogEnergy : public ssp::UnaryFunctor
+    {
+    public:
+        LogEnergy() : ssp::UnaryFunctor(1) {};
+    protected:
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    };
+
+    /**
+     * Discrete cosine transform of log filterbank energies to liftered
+     * cepstra c1..cN, i.e., MFCCs.
+     */
+    class DCT : public ssp::UnaryFunctor
+    {
+    public:
+        DCT(int iNCeps, int iNFilters, float iLifter=0.0f);
+    protected:
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    private:
+        int mNFilters;
+        std::vector<float> mMatrix;
+    };
+
+    /**
+     * The perceptual part of PLP: equal loudness weighting, intensity to
+     * loudness power law, then an inverse DFT of the resulting auditory
+     * spectrum to give an autocorrelation suitable for Levinson.
+     */
+    class PerceptualAC : public ssp::UnaryFunctor
+    {
+    public:
+        PerceptualAC(const FilterbankFeatures& iFB, int iNFilters, int iOrder);
+    protected:
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    private:
+        int mNFilters;
+        std::vector<float> mLoudness;
+        std::vector<float> mCosine;
+    };
+
+    /**
+     * Convert AR polynomial to liftered cepstra c1..cN
+     */
+    class ARCepstrum : public ssp::UnaryFunctor
+    {
+    public:
+        ARCepstrum(int iNCeps, int iOrder, float iLifter=0.0f);
+    protected:
+        void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    private:
+        int mOrder;
+        float mLifter;
+    };
+
+    /**
+     * Regression (delta) coefficients along the time axis of a [nFrames,
+     * nParams] matrix.  The ends are replicated.  For chunked streams, use
+     * core::Delta directly.
+     */
+    class Delta : public lube::UnaryFunctor
+    {
+    public:
+        Delta(int iWindow=2);
+    protected:
+        void vector(var iVar, var& oVar) const;
+    private:
+        int mWindow;
+    };
+
+    var appendDeltas(
+        var iStatic, int& ioKind, int iWindow=2, bool iAccel=false
+    );
+
+    /**
+     * Configurable MFCC / PLP / filterbank front end.  The output is one
+     * row per frame: static features, then energy, then deltas and
+     * accelerations of both.  kind() gives the corresponding HTK parameter
+     * kind, and write() writes the features as an HTK file.  With vad set,
+     * only the frames that VAD calls speech are returned; if there are none,
+     * the result is nil.  The deltas are still those of the whole stream,
+     * so each row is as it would be without vad; only the speech and the
+     * frames the deltas reach are analysed.
+     */
+    class FrontEnd : public lube::Config
+    {
+    public:
+        FrontEnd(PCM* iPCM, var iStr="FrontEnd");
+        var extract(var iSignal);
+        void write(var iFile, var iFeatures);
+        int kind();
+        float period();
+    private:
+        PCM* mPCM;
+        var mAttr;
+    };
+}
+
+#endif // FEATURE_H
@@ -0,0 +1,410 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <lube/dft.h>
+#include "fft.h"
+
+#ifdef SSP_FFTW
+# include <fftw3.h>
+#endif
+
+using namespace ssp;
+
+namespace
+{
+    /**
+     * Backend wrapping lube's DFT and IDFT.  Frames are copied into and out
+     * of a var, so this is the slow path for raw data.  The lube functors
+     * are shared by all users of the plan, so calls are serialised.
+     */
+    class LubeFFT : public core::RealFFT
+    {
+    public:
+        LubeFFT(int iSize)
+            : core::RealFFT(iSize), mDFT(iSize), mIDFT(iSize) {};
+        void forward(int iNFrames, const float* iReal, float* oComplex) const
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            int nc = mSize/2+1;
+            var x = lube::view({iNFrames, mSize}, 0.0f);
+            std::memcpy(x.ptr<float>(), iReal, iNFrames*mSize*sizeof(float));
+            var y = mDFT(x);
+            std::memcpy(
+                oComplex, y.ptr<lube::cfloat>(),
+                iNFrames*nc*sizeof(lube::cfloat)
+            );
+        };
+        void inverse(int iNFrames, const float* iComplex, float* oReal) const
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            int nc = mSize/2+1;
+            var x = lube::view({iNFrames, nc}, lube::cfloat(0.0f, 0.0f));
+            std::memcpy(
+                (float*)x.ptr<lube::cfloat>(), iComplex,
+                iNFrames*nc*sizeof(lube::cfloat)
+            );
+            var y = mIDFT(x);
+            std::memcpy(oReal, y.ptr<float>(), iNFrames*mSize*sizeof(float));
+        };
+    private:
+        lube::DFT mDFT;
+        lube::IDFT mIDFT;
+        mutable std::mutex mMutex;
+    };
+
+    /**
+     * Bundled radix-2 real FFT.  The size N real transform is done as a size
+     * N/2 complex transform of the even and odd samples packed as real and
+     * imaginary parts, followed by a split into the two half-size spectra.
+     */
+    class BundledFFT : public core::RealFFT
+    {
+    public:
+        BundledFFT(int iSize);
+        void forward(int iNFrames, const float* iReal, float* oComplex) const;
+        void inverse(int iNFrames, const float* iComplex, float* oReal) const;
+    private:
+        int mHalf;
+        std::vector<int> mReverse;
+        std::vector<float> mTwiddle; // Complex, mHalf/2, for the half size
+        std::vector<float> mSplit;   // Complex, mHalf+1, exp(-2 pi i k / N)
+        void complex(float* ioData, bool iInverse) const;
+        void split(
+            const float* iZ, const float* iC, int iK, float* oX
+        ) const;
+    };
+
+    BundledFFT::BundledFFT(int iSize)
+        : core::RealFFT(iSize)
+    {
+        if ((iSize < 2) || (iSize & (iSize-1)))
+            throw lube::error("BundledFFT: size must be a power of 2");
+        mHalf = iSize/2;
+        mReverse.resize(mHalf);
+        int bits = 0;
+        while ((1 << bits) < mHalf)
+            bits++;
+        for (int i=0; i<mHalf; i++)
+        {
+            int r = 0;
+            for (int b=0; b<bits; b++)
+                if (i & (1 << b))
+                    r |= 1 << (bits-1-b);
+            mReverse[i] = r;
+        }
+        mTwiddle.resize(mHalf > 1 ? mHalf : 2);
+        for (int k=0; k<mHalf/2; k++)
+        {
+            double a = -2.0 * M_PI * k / mHalf;
+            mTwiddle[k*2]   = (float)std::cos(a);
+            mTwiddle[k*2+1] = (float)std::sin(a);
+        }
+        mSplit.resize((mHalf+1)*2);
+        for (int k=0; k<=mHalf; k++)
+        {
+            double a = -2.0 * M_PI * k / iSize;
+            mSplit[k*2]   = (float)std::cos(a);
+            mSplit[k*2+1] = (float)std::sin(a);
+        }
+    }
+
+    /**
+     * In-place, unnormalised, iterative complex FFT of size mHalf.
+     */
+    void BundledFFT::complex(float* ioData, bool iInverse) const
+    {
+        for (int i=0; i<mHalf; i++)
+        {
+            int r = mReverse[i];
+            if (r > i)
+            {
+                std::swap(ioData[i*2],   ioData[r*2]);
+                std::swap(ioData[i*2+1], ioData[r*2+1]);
+            }
+        }
+        float sign = iInverse ? -1.0f : 1.0f;
+        for (int len=2; len<=mHalf; len*=2)
+        {
+            int stride = mHalf / len;
+            for (int i=0; i<mHalf; i+=len)
+                for (int j=0; j<len/2; j++)
+                {
+                    float wr = mTwiddle[j*stride*2];
+                    float wi = mTwiddle[j*stride*2+1] * sign;
+                    float* a = ioData + (i+j)*2;
+                    float* b = ioData + (i+j+len/2)*2;
+                    float tr = b[0]*wr - b[1]*wi;
+                    float ti = b[0]*wi + b[1]*wr;
+                    b[0] = a[0] - tr;
+                    b[1] = a[1] - ti;
+                    a[0] += tr;
+                    a[1] += ti;
+                }
+        }
+    }
+
+    /**
+     * Bin iK of the real spectrum, X[k] = E[k] + W^k O[k], with E and O the
+     * spectra of the even and odd samples recovered from the packed
+     * transform values iZ = Z[k] and iC = Z[N/2-k].
+     */
+    void BundledFFT::split(
+        const float* iZ, const float* iC, int iK, float* oX
+    ) const
+    {
+        float zr = iZ[0];
+        float zi = iZ[1];
+        float cr = iC[0];
+        float ci = -iC[1];
+        float er = 0.5f * (zr + cr);
+        float ei = 0.5f * (zi + ci);
+        float or_ =  0.5f * (zi - ci);
+        float oi  = -0.5f * (zr - cr);
+        float wr = mSplit[iK*2];
+        float wi = mSplit[iK*2+1];
+        oX[0] = er + wr*or_ - wi*oi;
+        oX[1] = ei + wr*oi  + wi*or_;
+    }
+
+    /**
+     * The half size transform is done in the output frame itself.  Bins k
+     * and N/2-k come from the same two values of Z, so are split in pairs;
+     * Z[0] gives both bin 0 and bin N/2.
+     */
+    void BundledFFT::forward(
+        int iNFrames, const float* iReal, float* oComplex
+    ) const
+    {
+        for (int f=0; f<iNFrames; f++)
+        {
+            const float* x = iReal + f*mSize;
+            float* y = oComplex + f*(mHalf+1)*2;
+            std::memcpy(y, x, mSize*sizeof(float));
+            complex(y, false);
+            for (int k=0; k<=mHalf/2; k++)
+            {
+                int j = mHalf-k;
+                float a[2] = {y[k*2], y[k*2+1]};
+                float b[2] = {y[(j % mHalf)*2], y[(j % mHalf)*2+1]};
+                split(a, b, k, y + k*2);
+                split(b, a, j, y + j*2);
+            }
+        }
+    }
+
+    void BundledFFT::inverse(
+        int iNFrames, const float* iComplex, float* oReal
+    ) const
+    {
+        float scale = 1.0f / mSize;
+        for (int f=0; f<iNFrames; f++)
+        {
+            const float* x = iComplex + f*(mHalf+1)*2;
+            float* y = oReal + f*mSize;
+            float* z = y;
+
+            // Z[k] = E[k] + i O[k], undoing the split of the forward
+            // transform, straight into the output frame.  The 1/2 is
+            // absorbed into the final scale.
+            for (int k=0; k<mHalf; k++)
+            {
+                float xr = x[k*2];
+                float xi = x[k*2+1];
+                float cr = x[(mHalf-k)*2];
+                float ci = -x[(mHalf-k)*2+1];
+                float er = xr + cr;
+                float ei = xi + ci;
+                float dr = xr - cr;
+                float di = xi - ci;
+                float wr = mSplit[k*2];
+                float wi = -mSplit[k*2+1];
+                float or_ = dr*wr - di*wi;
+                float oi  = dr*wi + di*wr;
+                z[k*2]   = er - oi;
+                z[k*2+1] = ei + or_;
+            }
+            complex(z, true);
+            for (int i=0; i<mSize; i++)
+                y[i] *= scale;
+        }
+    }
+
+#ifdef SSP_FFTW
+    /**
+     * FFTW backend.  The plans are made unaligned so they can be executed on
+     * any array via the new-array interface, which is thread safe.
+     */
+    class FFTWFFT : public core::RealFFT
+    {
+    public:
+        FFTWFFT(int iSize)
+            : core::RealFFT(iSize)
+        {
+            float r[iSize];
+            fftwf_complex c[iSize/2+1];
+            mForward = fftwf_plan_dft_r2c_1d(
+                iSize, r, c, FFTW_ESTIMATE | FFTW_UNALIGNED
+            );
+            mInverse = fftwf_plan_dft_c2r_1d(
+                iSize, c, r, FFTW_ESTIMATE | FFTW_UNALIGNED
+            );
+        };
+        ~FFTWFFT()
+        {
+            fftwf_destroy_plan(mForward);
+            fftwf_destroy_plan(mInverse);
+        };
+        void forward(int iNFrames, const float* iReal, float* oComplex) const
+        {
+            int nc = mSize/2+1;
+            for (int f=0; f<iNFrames; f++)
+                fftwf_execute_dft_r2c(
+                    mForward, const_cast<float*>(iReal + f*mSize),
+                    (fftwf_complex*)(oComplex + f*nc*2)
+                );
+        };
+        void inverse(int iNFrames, const float* iComplex, float* oReal) const
+        {
+            // c2r destroys its input, so work on a copy
+            int nc = mSize/2+1;
+            fftwf_complex c[nc];
+            float scale = 1.0f / mSize;
+            for (int f=0; f<iNFrames; f++)
+            {
+                std::memcpy(c, iComplex + f*nc*2, nc*sizeof(fftwf_complex));
+                float* y = oReal + f*mSize;
+                fftwf_execute_dft_c2r(mInverse, c, y);
+                for (int i=0; i<mSize; i++)
+                    y[i] *= scale;
+            }
+        };
+    private:
+        fftwf_plan mForward;
+        fftwf_plan mInverse;
+    };
+#endif
+
+    int sBackend = FFT_LUBE;
+    std::mutex sMutex;
+    std::map<std::pair<int, int>, core::RealFFT*> sPlans;
+}
+
+/**
+ * Sets the backend used when FFT_DEFAULT is requested.  Plans already
+ * handed out are not affected.
+ */
+void ssp::setFFTBackend(int iBackend)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    switch (iBackend)
+    {
+    case FFT_LUBE:
+    case FFT_BUNDLED:
+        break;
+    case FFT_FFTW:
+#ifdef SSP_FFTW
+        break;
+#else
+        throw lube::error("setFFTBackend: not built with FFTW");
+#endif
+    default:
+        throw lube::error("setFFTBackend: unknown backend");
+    }
+    sBackend = iBackend;
+}
+
+/**
+ * Returns the plan for a given size and backend, creating and caching it on
+ * first use.  Plans live until the process exits.
+ */
+const core::RealFFT& ssp::fftPlan(int iSize, int iBackend)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    if (iSize < 1)
+        throw lube::error("fftPlan: size must be positive");
+    int backend = (iBackend == FFT_DEFAULT) ? sBackend : iBackend;
+    if ((backend == FFT_BUNDLED) && ((iSize < 2) || (iSize & (iSize-1))))
+        backend = FFT_LUBE;
+    std::pair<int, int> key(backend, iSize);
+    auto it = sPlans.find(key);
+    if (it != sPlans.end())
+        return *it->second;
+
+    core::RealFFT* plan = 0;
+    switch (backend)
+    {
+    case FFT_LUBE:
+        plan = new LubeFFT(iSize);
+        break;
+    case FFT_BUNDLED:
+        plan = new BundledFFT(iSize);
+        break;
+#ifdef SSP_FFTW
+    case FFT_FFTW:
+        plan = new FFTWFFT(iSize);
+        break;
+#endif
+    default:
+        throw lube::error("fftPlan: backend not available");
+    }
+    sPlans[key] = plan;
+    return *plan;
+}
+
+RealDFT::RealDFT(int iSize, int iBackend)
+    : mFFT(fftPlan(iSize, iBackend))
+{
+    mDim = 2;
+}
+
+var RealDFT::alloc(var iVar) const
+{
+    var s = iVar.shape();
+    s[s.size()-1] = mFFT.size()/2+1;
+    return lube::view(s, lube::cfloat(0.0f, 0.0f));
+}
+
+void RealDFT::vector(var iVar, var& oVar) const
+{
+    int n = iVar.shape(iVar.dim()-1);
+    if (n != mFFT.size())
+        throw lube::error("RealDFT: input size doesn't match plan");
+    mFFT.forward(
+        iVar.size() / n, iVar.ptr<float>(), (float*)oVar.ptr<lube::cfloat>()
+    );
+}
+
+RealIDFT::RealIDFT(int iSize, int iBackend)
+    : mFFT(fftPlan(iSize, iBackend))
+{
+    mDim = 2;
+}
+
+var RealIDFT::alloc(var iVar) const
+{
+    var s = iVar.shape();
+    s[s.size()-1] = mFFT.size();
+    return lube::view(s, 0.0f);
+}
+
+void RealIDFT::vector(var iVar, var& oVar) const
+{
+    int n = iVar.shape(iVar.dim()-1);
+    if (n != mFFT.size()/2+1)
+        throw lube::error("RealIDFT: input size doesn't match plan");
+    mFFT.inverse(
+        iVar.size() / n, (float*)iVar.ptr<lube::cfloat>(), oVar.ptr<float>()
+    );
+}
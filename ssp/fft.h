@@ -0,0 +1,91 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <lube.h>
+
+namespace ssp
+{
+    /**
+     * FFT backends.  FFT_DEFAULT means whatever setFFTBackend() chose,
+     * initially FFT_LUBE.  FFT_BUNDLED is only for powers of 2; other sizes
+     * fall back to FFT_LUBE.  FFT_FFTW is only there if built with SSP_FFTW.
+     */
+    enum {
+        FFT_DEFAULT,
+        FFT_LUBE,
+        FFT_BUNDLED,
+        FFT_FFTW
+    };
+
+    namespace core
+    {
+        /**
+         * Real input FFT of a given size, applied to a batch of frames
+         *
+         * forward() takes iNFrames contiguous frames of size() reals to
+         * iNFrames frames of size()/2+1 complex values (interleaved real and
+         * imaginary).  inverse() does the opposite, including the division
+         * by size(), as does lube's IDFT.  One plan can be used by several
+         * threads at once: the bundled and FFTW plans hold no state that
+         * changes, and the lube plan serialises its calls.
+         */
+        class RealFFT
+        {
+        public:
+            RealFFT(int iSize) { mSize = iSize; };
+            virtual ~RealFFT() {};
+            int size() const { return mSize; };
+            virtual void forward(
+                int iNFrames, const float* iReal, float* oComplex
+            ) const = 0;
+            virtual void inverse(
+                int iNFrames, const float* iComplex, float* oReal
+            ) const = 0;
+        protected:
+            int mSize;
+        };
+    }
+
+    void setFFTBackend(int iBackend);
+    const core::RealFFT& fftPlan(int iSize, int iBackend=FFT_DEFAULT);
+
+    /**
+     * Functor for the real DFT of [nFrames, size] to [nFrames, size/2+1]
+     * complex, using a cached plan.  The frames are done in one batch.
+     */
+    class RealDFT : public lube::UnaryFunctor
+    {
+    public:
+        RealDFT(int iSize, int iBackend=FFT_DEFAULT);
+    protected:
+        var alloc(var iVar) const;
+        void vector(var iVar, var& oVar) const;
+    private:
+        const core::RealFFT& mFFT;
+    };
+
+    /**
+     * Functor for the inverse of RealDFT
+     */
+    class RealIDFT : public lube::UnaryFunctor
+    {
+    public:
+        RealIDFT(int iSize, int iBackend=FFT_DEFAULT);
+    protected:
+        var alloc(var iVar) const;
+        void vector(var iVar, var& oVar) const;
+    private:
+        const core::RealFFT& mFFT;
+    };
+}
+
+#endif // FFT_H
@@ -44,6 +44,14 @@ Filter::~Filter()
  */
 void Filter::set(int iNNumer, float* iNumer, int iNDenom, float* iDenom)
 {
+    if (mNumer)
+        delete [] mNumer;
+    if (mDenom)
+        delete [] mDenom;
+    mNumer = 0;
+    mDenom = 0;
+    mNNumer = 0;
+    mNDenom = 0;
     if (iNNumer > 0)
     {
         mNNumer = iNNumer;
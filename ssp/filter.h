@@ -15,7 +15,8 @@ namespace ssp
     namespace core
     {
         /**
-         * Filter class
+         * Filter class.  Float only, so Filter, Excitation and Resynthesis
+         * are too.
          */
         class Filter
         {
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <lube.h>
+#include "fixed.h"
+
+using namespace ssp;
+
+/*
+ * Round a 64 bit value down by iShift bits, to nearest
+ */
+static inline int64_t shiftRound(int64_t iVal, int iShift)
+{
+    return (iVal + ((int64_t)1 << (iShift-1))) >> iShift;
+}
+
+static inline int16_t saturate16(int64_t iVal)
+{
+    return (int16_t)std::max<int64_t>(-32768, std::min<int64_t>(32767, iVal));
+}
+
+int core::frames(int iNSamples, int iSize, int iPeriod, bool iPad)
+{
+    int n = iNSamples;
+    if (iPad)
+        n += iSize;
+    return (n - (iSize-iPeriod)) / iPeriod;
+}
+
+/*
+ * The input index of sample t of frame r, clamped to the signal as if it
+ * were padded
+ */
+static inline int index(int iNSamples, int iSize, int iPeriod, bool iPad,
+                        int r, int t)
+{
+    int i = r*iPeriod + t - (iPad ? iSize/2 : 0);
+    return std::max(0, std::min(iNSamples-1, i));
+}
+
+void core::frame(
+    int iNSamples, const int16_t* iSample, int iSize, int iPeriod,
+    const float* iWindow, float* oFrame, bool iPad
+)
+{
+    int nFrames = frames(iNSamples, iSize, iPeriod, iPad);
+    const float scale = 1.0f / 32768;
+    for (int r=0; r<nFrames; r++)
+    {
+        float* f = oFrame + r*iSize;
+        for (int t=0; t<iSize; t++)
+        {
+            int i = index(iNSamples, iSize, iPeriod, iPad, r, t);
+            f[t] = iSample[i] * scale * iWindow[t];
+        }
+    }
+}
+
+void core::frameQ15(
+    int iNSamples, const int16_t* iSample, int iSize, int iPeriod,
+    const int16_t* iWindow, int16_t* oFrame, bool iPad
+)
+{
+    int nFrames = frames(iNSamples, iSize, iPeriod, iPad);
+    for (int r=0; r<nFrames; r++)
+    {
+        int16_t* f = oFrame + r*iSize;
+        for (int t=0; t<iSize; t++)
+        {
+            int i = index(iNSamples, iSize, iPeriod, iPad, r, t);
+            // Only -1 by -1 can overflow, so saturate
+            int32_t x = (int32_t)iSample[i] * iWindow[t];
+            f[t] = saturate16(shiftRound(x, 15));
+        }
+    }
+}
+
+int core::autocorrelationQ15(
+    int iSize, int iLags, const int16_t* iData, int32_t* oLag
+)
+{
+    // Sum in Q30; 64 bits is plenty for any sensible frame
+    int p = iLags-1;
+    int64_t sum[iLags];
+    int64_t max = 0;
+    for (int i=0; i<iLags; i++)
+    {
+        int64_t s = 0;
+        for (int j=iSize-1; j>=p; j--)
+            s += (int32_t)iData[j] * iData[j-i];
+        sum[i] = s;
+        max = std::max(max, s < 0 ? -s : s);
+    }
+    if (max == 0)
+    {
+        for (int i=0; i<iLags; i++)
+            oLag[i] = 0;
+        return 0;
+    }
+
+    // Block floating point; the biggest lag goes in [2^30, 2^31)
+    int shift = 0;
+    while (max >= ((int64_t)1 << 31))
+    {
+        max >>= 1;
+        shift--;
+    }
+    while (max < ((int64_t)1 << 30))
+    {
+        max <<= 1;
+        shift++;
+    }
+    for (int i=0; i<iLags; i++)
+    {
+        int64_t l = (shift < 0)
+            ? shiftRound(sum[i], -shift)
+            : sum[i] * ((int64_t)1 << shift);
+        oLag[i] = (int32_t)std::max<int64_t>(
+            INT32_MIN, std::min<int64_t>(INT32_MAX, l)
+        );
+    }
+    return shift;
+}
+
+int32_t core::levinsonQ31(
+    int iOrder, const int32_t* iLag, int32_t* oAR, int32_t iPrior
+)
+{
+    const int32_t one = 1 << 24;
+    int32_t c[iOrder+1];
+    int32_t p[iOrder+1];
+    int32_t* curr = c;
+    int32_t* prev = p;
+    curr[0] = prev[0] = one;
+    for (int i=1; i<=iOrder; i++)
+        curr[i] = prev[i] = 0;
+    int64_t error = std::min<int64_t>(
+        INT32_MAX, (int64_t)iLag[0] + iPrior
+    );
+    if (error <= 0)
+    {
+        for (int i=0; i<=iOrder; i++)
+            oAR[i] = curr[i];
+        return 0;
+    }
+
+    for (int i=1; i<=iOrder; i++)
+    {
+        int32_t* tmp = curr;
+        curr = prev;
+        prev = tmp;
+
+        // The sum is in units of the lags times 2^16, i.e., each Q24 by lag
+        // product loses 8 bits; that keeps 64 bits from overflowing.
+        int64_t acc = (int64_t)iLag[i] * 65536;
+        for (int j=1; j<i; j++)
+            acc += shiftRound((int64_t)prev[j] * iLag[i-j], 8);
+
+        // Q31 reflection coefficient, which should be inside +/-1; if the
+        // recursion went unstable it is pinned to the edge
+        int32_t k;
+        int64_t mag = acc < 0 ? -acc : acc;
+        if (mag >= (error << 16))
+            k = (acc < 0) ? INT32_MAX : -INT32_MAX;
+        else
+            k = (int32_t)(-(acc * 32768) / error);
+
+        curr[i] = (int32_t)shiftRound(k, 7);
+        for (int j=1; j<i; j++)
+            curr[j] = prev[j] + shiftRound((int64_t)k * prev[i-j], 31);
+        int64_t k2 = shiftRound((int64_t)k * k, 31);
+        error -= shiftRound(error * k2, 31);
+        if (error < 1)
+            error = 1;
+    }
+
+    for (int i=0; i<=iOrder; i++)
+        oAR[i] = curr[i];
+    return (int32_t)error;
+}
+
+core::BiquadQ15::BiquadQ15(const float* iNumer, const float* iDenom)
+{
+    // The denominator is stored negated, without the leading 1.0
+    const double scale = 1 << 30;
+    for (int i=0; i<3; i++)
+    {
+        if (std::abs(iNumer[i] / iDenom[0]) >= 2.0f)
+            throw lube::error("BiquadQ15: coefficient out of range");
+        mNumer[i] = (int32_t)std::lround(iNumer[i] / iDenom[0] * scale);
+    }
+    for (int i=0; i<2; i++)
+    {
+        if (std::abs(iDenom[i+1] / iDenom[0]) >= 2.0f)
+            throw lube::error("BiquadQ15: coefficient out of range");
+        mDenom[i] = (int32_t)std::lround(-iDenom[i+1] / iDenom[0] * scale);
+    }
+}
+
+void core::BiquadQ15::operator ()(
+    int iNSamples, const int16_t* iSample, int16_t* oSample, int16_t* ioState
+) const
+{
+    // State is x[n-1], x[n-2], y[n-1], y[n-2]
+    int16_t x1 = ioState[0];
+    int16_t x2 = ioState[1];
+    int16_t y1 = ioState[2];
+    int16_t y2 = ioState[3];
+    for (int i=0; i<iNSamples; i++)
+    {
+        int16_t x = iSample[i];
+        int64_t acc =
+            (int64_t)mNumer[0] * x +
+            (int64_t)mNumer[1] * x1 +
+            (int64_t)mNumer[2] * x2 +
+            (int64_t)mDenom[0] * y1 +
+            (int64_t)mDenom[1] * y2;
+        int16_t y = saturate16(shiftRound(acc, 30));
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        oSample[i] = y;
+    }
+    ioState[0] = x1;
+    ioState[1] = x2;
+    ioState[2] = y1;
+    ioState[3] = y2;
+}
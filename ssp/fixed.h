@@ -0,0 +1,99 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <cstdint>
+
+namespace ssp
+{
+    namespace core
+    {
+        /*
+         * Fixed point kernels for 16 bit audio.  Samples are Q15, i.e., the
+         * int16 value over 32768, as they come from the file.  Products are
+         * accumulated in 64 bits so nothing overflows before the result is
+         * scaled.
+         */
+
+        /**
+         * The number of frames of iSize every iPeriod samples in iNSamples;
+         * the same as ssp::Frame.
+         */
+        int frames(int iNSamples, int iSize, int iPeriod, bool iPad=true);
+
+        /**
+         * Frame and window 16 bit samples into [frames(), iSize] floats.  The
+         * conversion to float is done sample by sample on the way, so the
+         * signal itself is never converted.  With iPad, the ends are padded
+         * by repeating the end samples as ssp::Frame does.
+         */
+        void frame(
+            int iNSamples, const int16_t* iSample, int iSize, int iPeriod,
+            const float* iWindow, float* oFrame, bool iPad=true
+        );
+
+        /**
+         * As frame(), but the window is Q15 and so are the frames, which
+         * saturate.  PCMReader reads 16 bit files into blocks for these.
+         */
+        void frameQ15(
+            int iNSamples, const int16_t* iSample, int iSize, int iPeriod,
+            const int16_t* iWindow, int16_t* oFrame, bool iPad=true
+        );
+
+        /**
+         * Autocorrelation of a Q15 frame as ssp::Autocorrelation.  The lags
+         * are in block floating point: scaled together so that the first is
+         * in [2^30, 2^31).  The return value is the shift s such that the
+         * float autocorrelation is
+         *   oLag[i] * 2^-(30+s) / (iSize - (iLags-1))
+         * A silent frame gives all zeros and a shift of 0.
+         */
+        int autocorrelationQ15(
+            int iSize, int iLags, const int16_t* iData, int32_t* oLag
+        );
+
+        /**
+         * Levinson-Durbin recursion as ssp::Levinson on Q31 autocorrelation,
+         * e.g., from autocorrelationQ15(); only the ratios matter, so the
+         * block floating point shift can be ignored.  iPrior is added to
+         * lag 0, in the same units.  Reflection coefficients and the error
+         * are Q31; the iOrder+1 AR coefficients are Q24, range +/-128, as
+         * they can be bigger than 1.  Returns the prediction error, in the
+         * units of the input.
+         */
+        int32_t levinsonQ31(
+            int iOrder, const int32_t* iLag, int32_t* oAR, int32_t iPrior=0
+        );
+
+        /**
+         * Biquad on Q15 samples.  The coefficients are Q30, so there is room
+         * for the +/-2 of the denominator, and the precision for poles near
+         * the unit circle such as in the cochleas.  It's direct form I, so
+         * the state is the last two inputs and outputs; the output
+         * saturates.
+         */
+        class BiquadQ15
+        {
+        public:
+            BiquadQ15(const float* iNumer, const float* iDenom);
+            void operator ()(
+                int iNSamples, const int16_t* iSample, int16_t* oSample,
+                int16_t* ioState
+            ) const;
+        private:
+            int32_t mNumer[3];
+            int32_t mDenom[2];
+        };
+    }
+}
+
+#endif // FIXED_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <lube.h>
+
+#include "htk.h"
+
+using namespace ssp;
+
+HTKWriter::HTKWriter()
+{
+    mFD = -1;
+    mVecSize = 0;
+    mNSamples = 0;
+    mNHeader = 0;
+    mBuffer.resize(cBufferSize);
+    mNBuffer = 0;
+}
+
+HTKWriter::HTKWriter(
+    const char* iFile, int iVecSize, float iPeriod, int iKind, int iNSamples
+)
+    : HTKWriter()
+{
+    open(iFile, iVecSize, iPeriod, iKind, iNSamples);
+}
+
+HTKWriter::~HTKWriter()
+{
+    // Destructors shouldn't throw
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+/**
+ * Open the file and put the 12 byte header in the buffer.  iNSamples is what
+ * the header will say unless close() finds otherwise.
+ */
+void HTKWriter::open(
+    const char* iFile, int iVecSize, float iPeriod, int iKind, int iNSamples
+)
+{
+    close();
+    mFD = ::open(iFile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (mFD < 0)
+        throw lube::error("HTKWriter::open(): Open failed");
+    mVecSize = iVecSize;
+    mNSamples = 0;
+    mNHeader = iNSamples;
+
+    int nSamples = iNSamples;
+    int sampPeriod = iPeriod * 1e7 + 0.5;
+    short sampSize = iVecSize * sizeof(float);
+    short parmKind = iKind;
+    std::memcpy(&mBuffer[0], &nSamples, 4);
+    std::memcpy(&mBuffer[4], &sampPeriod, 4);
+    std::memcpy(&mBuffer[8], &sampSize, 2);
+    std::memcpy(&mBuffer[10], &parmKind, 2);
+    mNBuffer = 12;
+}
+
+/**
+ * Write out the buffer, followed by iSize bytes of iData if given, in one
+ * system call (give or take partial writes).
+ */
+void HTKWriter::flush(const char* iData, long iSize)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = &mBuffer[0];
+    iov[0].iov_len = mNBuffer;
+    iov[1].iov_base = (void*)iData;
+    iov[1].iov_len = iSize;
+    struct iovec* v = iov;
+    int nv = 2;
+    while (nv > 0)
+    {
+        ssize_t n = ::writev(mFD, v, nv);
+        if (n < 0)
+            throw lube::error("HTKWriter::flush(): Write failed");
+        while ((nv > 0) && ((size_t)n >= v->iov_len))
+        {
+            n -= v->iov_len;
+            v++;
+            nv--;
+        }
+        if (nv > 0)
+        {
+            v->iov_base = (char*)v->iov_base + n;
+            v->iov_len -= n;
+        }
+    }
+    mNBuffer = 0;
+}
+
+/**
+ * Write iNFrames frames.  Consecutive frames start iStride floats apart; the
+ * default of 0 means they are contiguous.
+ */
+void HTKWriter::write(int iNFrames, const float* iData, int iStride)
+{
+    if (mFD < 0)
+        throw lube::error("HTKWriter::write(): File not open");
+    if ((iStride == 0) || (iStride == mVecSize))
+    {
+        // Contiguous: big blocks go straight out after the buffer
+        long n = (long)iNFrames * mVecSize * sizeof(float);
+        if (mNBuffer + n > cBufferSize)
+            flush((const char*)iData, n);
+        else
+        {
+            std::memcpy(mBuffer.data() + mNBuffer, iData, n);
+            mNBuffer += n;
+        }
+        mNSamples += iNFrames;
+        return;
+    }
+    part p = {iData, mVecSize, iStride};
+    write(iNFrames, 1, &p);
+}
+
+/**
+ * Write iNFrames frames, each of which is the concatenation of the given
+ * parts.  Part i of frame f is iPart[i].size floats starting at
+ * iPart[i].data + f * iPart[i].stride.
+ */
+void HTKWriter::write(int iNFrames, int iNParts, const part* iPart)
+{
+    if (mFD < 0)
+        throw lube::error("HTKWriter::write(): File not open");
+    long frameBytes = mVecSize * sizeof(float);
+    if (frameBytes > cBufferSize)
+        throw lube::error("HTKWriter::write(): Vector too large");
+    for (int f=0; f<iNFrames; f++)
+    {
+        if (mNBuffer + frameBytes > cBufferSize)
+            flush();
+        float* b = (float*)(mBuffer.data() + mNBuffer);
+        int size = 0;
+        for (int i=0; i<iNParts; i++)
+        {
+            const part& p = iPart[i];
+            size += p.size;
+            if (size > mVecSize)
+                throw lube::error("HTKWriter::write(): Parts too large");
+            std::memcpy(b, p.data + (long)f*p.stride, p.size*sizeof(float));
+            b += p.size;
+        }
+        if (size != mVecSize)
+            throw lube::error("HTKWriter::write(): Parts too small");
+        mNBuffer += frameBytes;
+    }
+    mNSamples += iNFrames;
+}
+
+/**
+ * Flush the buffer, patch the number of samples in the header if the guess
+ * was wrong, and close the file.
+ */
+void HTKWriter::close()
+{
+    if (mFD < 0)
+        return;
+    bool ok = true;
+    try
+    {
+        if (mNBuffer)
+            flush();
+    }
+    catch (...)
+    {
+        ok = false;
+    }
+    if (ok && (mNSamples != mNHeader))
+        ok = (::pwrite(mFD, &mNSamples, 4, 0) == 4);
+    if (::close(mFD) != 0)
+        ok = false;
+    mFD = -1;
+    mNBuffer = 0;
+    if (!ok)
+        throw lube::error("HTKWriter::close(): Write failed");
+}
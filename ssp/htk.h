@@ -0,0 +1,85 @@
+/*
+ * Copyright 2015 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, April 2015
+ */
+
+#ifndef HTK_H
+#define HTK_H
+
+#include <vector>
+
+namespace ssp
+{
+    /**
+     * HTK parameter kinds
+     */
+    enum {
+        HTK_LPC =       1,
+        HTK_LPREFC =    2,
+        HTK_LPCEPSTRA = 3,
+        HTK_MFCC =      6,
+        HTK_FBANK =     7,
+        HTK_MELSPEC =   8,
+        HTK_USER =      9,
+        HTK_PLP =      11,
+        HTK_E =   0000100,
+        HTK_N =   0000200,
+        HTK_D =   0000400,
+        HTK_A =   0001000,
+        HTK_Z =   0004000,
+        HTK_0 =   0020000,
+        HTK_T =   0100000
+    };
+
+    /**
+     * Writer for HTK feature files
+     *
+     * Data can be written all at once or a few frames at a time; either
+     * way, it goes through one buffer with the header, so a whole file
+     * normally costs one system call.  The frames can be gathered from
+     * several strided arrays, so there is no need to copy non-contiguous
+     * parameters into a matrix first.  The header is written with
+     * iNSamples, and patched on close() if a different number of frames
+     * turned up, e.g., when streaming.
+     */
+    class HTKWriter
+    {
+    public:
+        struct part
+        {
+            const float* data;
+            int size;
+            int stride;
+        };
+        HTKWriter();
+        HTKWriter(
+            const char* iFile, int iVecSize, float iPeriod,
+            int iKind=HTK_USER, int iNSamples=0
+        );
+        ~HTKWriter();
+        HTKWriter(const HTKWriter&) = delete;
+        HTKWriter& operator=(const HTKWriter&) = delete;
+        void open(
+            const char* iFile, int iVecSize, float iPeriod,
+            int iKind=HTK_USER, int iNSamples=0
+        );
+        void write(int iNFrames, const float* iData, int iStride=0);
+        void write(int iNFrames, int iNParts, const part* iPart);
+        void close();
+    private:
+        void flush(const char* iData=0, long iSize=0);
+        static const int cBufferSize = 65536;
+        int mFD;
+        int mVecSize;
+        int mNSamples;
+        int mNHeader;
+        std::vector<char> mBuffer;
+        long mNBuffer;
+    };
+}
+
+#endif // HTK_H
@@ -10,30 +10,10 @@
 #include <cassert>
 #include <fstream>
 #include <lube/module.h>
+#include "htk.h"
 
 namespace libube
 {
-    /**
-     * HTK parameter kinds
-     */
-    enum {
-        HTK_LPC =       1,
-        HTK_LPREFC =    2,
-        HTK_LPCEPSTRA = 3,
-        HTK_MFCC =      6,
-        HTK_FBANK =     7,
-        HTK_MELSPEC =   8,
-        HTK_USER =      9,
-        HTK_PLP =      11,
-        HTK_E =   0000100,
-        HTK_N =   0000200,
-        HTK_D =   0000400,
-        HTK_A =   0001000,
-        HTK_Z =   0004000,
-        HTK_0 =   0020000,
-        HTK_T =   0100000
-    };
-
     /**
      * Class to handle HTK feature format files
      */
@@ -57,6 +37,7 @@ namespace libube
 
 
 using namespace libube;
+using namespace ssp;
 
 HTK::HTK(var iAttr)
 {
@@ -105,26 +86,12 @@ var HTK::read(var iFile)
 
 void HTK::write(var iFile, var iVar)
 {
-    // Prepare the header
+    // Header and data go out together through the writer's buffer
     int nSamples = iVar.shape(-2);
-    int sampPeriod = mAttr["period"].cast<float>() * 1e7 + 0.5;
-    short sampSize = iVar.shape(-1) * sizeof(float);
-    short parmKind = mAttr["kind"].cast<int>();
-
-    // Open the file
-    std::ofstream os(iFile.str(), std::ofstream::out | std::ofstream::binary);
-    if (os.fail())
-        throw error("htkfile::write(): Open failed");
-
-    // Write the header
-    os.write((char*)&nSamples, 4);
-    os.write((char*)&sampPeriod, 4);
-    os.write((char*)&sampSize, 2);
-    os.write((char*)&parmKind, 2);
-
-    // And the rest
-    int n = nSamples * sampSize;
-    os.write(iVar.ptr<char>(), n);
-    if (os.fail())
-        throw error("htkfile::write(): Write failed");
+    HTKWriter os(
+        iFile.str(), iVar.shape(-1),
+        mAttr["period"].cast<float>(), mAttr["kind"].cast<int>(), nSamples
+    );
+    os.write(nSamples, iVar.ptr<float>());
+    os.close();
 }
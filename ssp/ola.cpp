@@ -0,0 +1,121 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <lube.h>
+#include "ola.h"
+
+using namespace ssp::core;
+
+OverlapAdd::OverlapAdd(
+    int iSize, int iPeriod, const float* iWindow, bool iNormalise
+)
+{
+    if ((iPeriod < 1) || (iPeriod > iSize))
+        throw lube::error("OverlapAdd: period must be 1 to frame size");
+    mSize = iSize;
+    mPeriod = iPeriod;
+    if (iWindow)
+        mWindow.assign(iWindow, iWindow + mSize);
+    if (iNormalise)
+    {
+        // The sum is periodic in the frame period
+        mNorm.resize(mPeriod);
+        for (int i=0; i<mPeriod; i++)
+        {
+            float sum = 0.0f;
+            for (int j=i; j<mSize; j+=mPeriod)
+                sum += iWindow ? iWindow[j] * iWindow[j] : 1.0f;
+            mNorm[i] = (sum > 1e-8f) ? 1.0f / sum : 1.0f;
+        }
+    }
+    mAccum.resize(mSize);
+    reset();
+}
+
+void OverlapAdd::reset()
+{
+    std::fill(mAccum.begin(), mAccum.end(), 0.0f);
+    mStarted = false;
+}
+
+/**
+ * Add one frame into the output.  Both loops are contiguous so the compiler
+ * can vectorise them.
+ */
+void OverlapAdd::add(const float* iFrame, float* ioSample) const
+{
+    if (!mWindow.empty())
+        for (int j=0; j<mSize; j++)
+            ioSample[j] += mWindow[j] * iFrame[j];
+    else
+        for (int j=0; j<mSize; j++)
+            ioSample[j] += iFrame[j];
+}
+
+/**
+ * Apply the normalisation to samples starting on a period boundary
+ */
+void OverlapAdd::normalise(int iNSamples, float* ioSample) const
+{
+    if (mNorm.empty())
+        return;
+    for (int i=0; i<iNSamples; i+=mPeriod)
+    {
+        int n = (iNSamples-i < mPeriod) ? iNSamples-i : mPeriod;
+        float* o = ioSample + i;
+        for (int j=0; j<n; j++)
+            o[j] *= mNorm[j];
+    }
+}
+
+void OverlapAdd::operator()(int iNFrames, const float* iFrame, float* oSample)
+    const
+{
+    int n = size(iNFrames);
+    std::memset(oSample, 0, n*sizeof(float));
+    for (int f=0; f<iNFrames; f++)
+        add(iFrame + (long)f*mSize, oSample + (long)f*mPeriod);
+    normalise(n, oSample);
+}
+
+/**
+ * Push iNFrames frames, writing the iNFrames*iPeriod samples that are then
+ * complete.  Returns the number of samples written.
+ */
+int OverlapAdd::push(int iNFrames, const float* iFrame, float* oSample)
+{
+    float* a = &mAccum[0];
+    for (int f=0; f<iNFrames; f++)
+    {
+        add(iFrame + (long)f*mSize, a);
+        float* o = oSample + (long)f*mPeriod;
+        std::memcpy(o, a, mPeriod*sizeof(float));
+        normalise(mPeriod, o);
+        std::memmove(a, a+mPeriod, (mSize-mPeriod)*sizeof(float));
+        std::memset(a+mSize-mPeriod, 0, mPeriod*sizeof(float));
+    }
+    if (iNFrames)
+        mStarted = true;
+    return iNFrames*mPeriod;
+}
+
+/**
+ * End of stream: write the tail of the last frame and reset.  Returns the
+ * number of samples written.
+ */
+int OverlapAdd::flush(float* oSample)
+{
+    int n = mStarted ? mSize-mPeriod : 0;
+    std::memcpy(oSample, &mAccum[0], n*sizeof(float));
+    normalise(n, oSample);
+    reset();
+    return n;
+}
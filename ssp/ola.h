@@ -0,0 +1,62 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef OLA_H
+#define OLA_H
+
+#include <vector>
+
+namespace ssp
+{
+    namespace core
+    {
+        /**
+         * Overlap-add of frames of iSize samples every iPeriod samples.
+         *
+         * If a synthesis window is given, each frame is multiplied by it
+         * before adding.  If iNormalise is set, the output is divided by
+         * the steady state sum of the overlapping (squared) windows, i.e.,
+         * weighted overlap-add assuming the same analysis window; with no
+         * window this is the number of overlapping frames.
+         *
+         * operator() does a whole [nFrames, iSize] array into
+         * size(nFrames) samples.  push() does the same on a stream: each
+         * frame completes iPeriod samples, and flush() writes the last
+         * iSize-iPeriod.
+         */
+        class OverlapAdd
+        {
+        public:
+            OverlapAdd(
+                int iSize, int iPeriod,
+                const float* iWindow=0, bool iNormalise=false
+            );
+            int size(int iNFrames) const
+            {
+                return iNFrames ? (iNFrames-1) * mPeriod + mSize : 0;
+            };
+            void operator()(int iNFrames, const float* iFrame, float* oSample)
+                const;
+            int push(int iNFrames, const float* iFrame, float* oSample);
+            int flush(float* oSample);
+            void reset();
+        private:
+            void add(const float* iFrame, float* ioSample) const;
+            void normalise(int iNSamples, float* ioSample) const;
+            int mSize;
+            int mPeriod;
+            std::vector<float> mWindow;
+            std::vector<float> mNorm;
+            std::vector<float> mAccum;
+            bool mStarted;
+        };
+    }
+}
+
+#endif // OLA_H
@@ -7,10 +7,14 @@
  *   Phil Garner, February 2015
  */
 
+#include <cmath>
 #include <cassert>
+#include <algorithm>
+#include <vector>
 
 #include <lube/c++blas.h>
 #include "pitch.h"
+#include "yin.h"
 
 using namespace ssp;
 
@@ -153,12 +157,17 @@ void PitchHNR::vector(var iVar, var& oVar) const
     oVar[1] = 1.0f / hnr * range * range;
 }
 
-Pitch::Pitch(PCM* iPCM, var iLo, var iHi)
+/**
+ * The autocorrelation is by the (zero padded) periodogram method unless
+ * iDirect is set, in which case it's the direct sum.
+ */
+Pitch::Pitch(PCM* iPCM, var iLo, var iHi, bool iDirect)
     : UnaryFunctor(2)
 {
     mPCM = iPCM;
     mLo = iLo;
     mHi = iHi;
+    mDirect = iDirect;
 }
 
 void Pitch::scalar(const var& iVar, var& oVar) const
@@ -167,14 +176,25 @@ void Pitch::scalar(const var& iVar, var& oVar) const
     var w = gaussian(size);
     var f = iVar * w;
 
-    Autocorrelation acorr(size);
+    var wac;
+    var ac;
+    if (mDirect)
+    {
+        Autocorrelation acorr(size);
+        wac = acorr(w);
+        ac = acorr(f);
+    }
+    else
+    {
+        AutocorrelationP acorr(size);
+        wac = acorr(w);
+        ac = acorr(f);
+    }
+
     NormAC normac;
-    var wac = acorr(w);
     normac(wac, wac);
     for (int i=0; i<wac.size(); i++)
         wac(i) = var(1.0f) / wac(i);
-
-    var ac = acorr(f);
     normac(ac, ac);
     ac *= wac;
 
@@ -197,33 +217,125 @@ void Pitch::scalar(const var& iVar, var& oVar) const
 #endif
 }
 
-var ssp::excitation(var iPitch, var iHNR, PCM* iPCM)
+PitchYIN::PitchYIN(PCM* iPCM, int iSize, int iPeriod, var iLo, var iHi)
+{
+    mDim = 1;
+    mPCM = iPCM;
+    mSize = iSize;
+    mPeriod = iPeriod;
+    mLo = iLo;
+    mHi = iHi;
+}
+
+var PitchYIN::alloc(var iVar) const
+{
+    // Same number of frames as a padded Frame
+    var sh = iVar.shape();
+    int n = sh.top().get<int>();
+    sh[sh.size()-1] = n / mPeriod + 1;
+    sh.push(2);
+    return lube::view(sh, iVar.at(0));
+}
+
+void PitchYIN::vector(var iVar, var& oVar) const
+{
+    int minLag = mPCM->secondsToSamples(var(1.0f) / mHi);
+    int maxLag = mPCM->secondsToSamples(var(1.0f) / mLo);
+    core::DifferencePitch yin(mSize, mPeriod, minLag, maxLag);
+
+    // Pad with the end samples such that frames are centred as in Frame
+    int n = iVar.size();
+    int nFrames = oVar.shape(0);
+    int len = yin.length(nFrames);
+    int pre = mSize/2;
+    float* x = iVar.ptr<float>();
+    float* sig = new float[len];
+    for (int i=0; i<len; i++)
+    {
+        int j = std::min(std::max(i-pre, 0), n-1);
+        sig[i] = x[j];
+    }
+    std::vector<float> lag(nFrames);
+    std::vector<float> aper(nFrames);
+    yin(nFrames, sig, lag.data(), aper.data());
+    delete [] sig;
+
+    // Aperiodicity plays the part of 1 - nac in PitchHNR
+    var phnr = lube::view({nFrames, 2}, 0.0f);
+    float* p = phnr.ptr<float>();
+    float range = (mHi-mLo).cast<float>();
+    for (int i=0; i<nFrames; i++)
+    {
+        float a = std::max(aper[i], 1e-6f);
+        float hnr = (a < 1.0f) ? (1.0f - a) / a : 1e-8f;
+        p[i*2] = 1.0f / mPCM->samplesToSeconds(lag[i]);
+        p[i*2+1] = 1.0f / hnr * range * range;
+    }
+
+    var prange = mHi-mLo;
+    Kalman kalman(1e3, mLo + prange/2, prange*prange);
+    kalman(phnr, oVar);
+}
+
+/**
+ * Excitation of impulses at the pitch period mixed with noise according to
+ * HNR, for frames every iPeriod samples.  The default result is framed (with
+ * frame f centred on sample f*iPeriod) and windowed for overlap-add.  If
+ * iFramed is false it is a continuous signal with the mix interpolated
+ * between frame centres.  It then spans what the overlap-add of the frames
+ * would, so frame f is centred on sample (f+1)*iPeriod.
+ */
+var ssp::excitation(
+    var iPitch, var iHNR, PCM* iPCM, int iPeriod, bool iFramed
+)
 {
-    int framePeriod = 128;
-    int frameSize = framePeriod * 2;
+    int frameSize = iPeriod * 2;
     int nFrames = iPitch.size();
-    int nSamples = framePeriod * (nFrames-1);
+    int lead = iFramed ? 0 : iPeriod;
+    int nSamples = iPeriod * (nFrames-1) + lead*2;
 
-    // Construct an impulse sequence and frame it
+    // Construct an impulse sequence
     var h(nSamples, 0.0f);
     int i = 0;
     int f = 0;
-    while ((i < nSamples) && (f < nFrames))
+    while (i < nSamples)
     {
         int period = iPCM->secondsToSamples(var(1.0) / iPitch[f]);
         if (i + period > nSamples)
             break;
         h[i] = sqrt((float)period);
         i += period;
-        f = i / framePeriod;
+        f = std::min(std::max(0, (i - lead) / iPeriod), nFrames-1);
     }
-    Frame frame(frameSize, framePeriod);
-    var fh = frame(h);
 
-    // Construct a noise sequence and frame it
+    // Construct a noise sequence
     var zero = {-0.5f, 1.0f};
     Filter ri(zero);
     var n = ri(normal(nSamples));
+
+    if (!iFramed)
+    {
+        // Mix them (into n) sample by sample
+        std::vector<float> hnr(nFrames);
+        for (f=0; f<nFrames; f++)
+            hnr[f] = iHNR[f].cast<float>();
+        float* ph = h.ptr<float>();
+        float* pn = n.ptr<float>();
+        for (i=0; i<nSamples; i++)
+        {
+            float t = (float)(i - lead) / iPeriod;
+            int f0 = std::min(std::max(0, (int)std::floor(t)), nFrames-1);
+            int f1 = std::min(f0+1, nFrames-1);
+            float a = std::min(std::max(t - f0, 0.0f), 1.0f);
+            float sn = 1.0f / ((1.0f-a) * hnr[f0] + a * hnr[f1] + 1.0f);
+            pn[i] = std::sqrt(sn) * pn[i] + std::sqrt(1.0f-sn) * ph[i];
+        }
+        return n;
+    }
+
+    // Frame them
+    Frame frame(frameSize, iPeriod);
+    var fh = frame(h);
     var fn = frame(n);
 
     // Add them (into fn)
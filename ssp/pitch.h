@@ -24,15 +24,44 @@ namespace ssp
     class Pitch : public ssp::UnaryFunctor
     {
     public:
-        Pitch(PCM* iPCM, var iLo = 40.0f, var iHi = 500.0f);
+        Pitch(
+            PCM* iPCM, var iLo = 40.0f, var iHi = 500.0f, bool iDirect = false
+        );
     protected:
         void scalar(const var& iVar, var& oVar) const;
         PCM* mPCM;
         var mLo;
         var mHi;
+        bool mDirect;
     };
 
-    var excitation(var iPitch, var iHNR, PCM* iPCM);
+    /**
+     * Alternative to Pitch using the incremental difference function of
+     * core::DifferencePitch (YIN).  It takes the signal rather than frames,
+     * but gives the same [nFrames, 2] of pitch and variance as Pitch for
+     * frames of iSize every iPeriod (centred, as Frame does), via the same
+     * Kalman smoother.
+     */
+    class PitchYIN : public lube::UnaryFunctor
+    {
+    public:
+        PitchYIN(
+            PCM* iPCM, int iSize, int iPeriod,
+            var iLo = 40.0f, var iHi = 500.0f
+        );
+    protected:
+        var alloc(var iVar) const;
+        void vector(var iVar, var& oVar) const;
+        PCM* mPCM;
+        int mSize;
+        int mPeriod;
+        var mLo;
+        var mHi;
+    };
+
+    var excitation(
+        var iPitch, var iHNR, PCM* iPCM, int iPeriod, bool iFramed=true
+    );
 };
 
 #endif // PITCH_H
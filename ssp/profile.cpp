@@ -0,0 +1,116 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cstdio>
+#include <mutex>
+#include "profile.h"
+
+using namespace ssp;
+
+namespace
+{
+    std::mutex sMutex;
+    std::map<std::string, profile::Stage> sStage;
+
+    // Must be called with the mutex held
+    profile::Stage& stage(const char* iStage)
+    {
+        auto it = sStage.find(iStage);
+        if (it == sStage.end())
+        {
+            profile::Stage s = {};
+            it = sStage.insert(std::make_pair(std::string(iStage), s)).first;
+        }
+        return it->second;
+    }
+}
+
+profile::Timer::Timer(const char* iStage)
+{
+    mStage = iStage;
+    mStart = std::chrono::steady_clock::now();
+    mRunning = true;
+}
+
+void profile::Timer::stop()
+{
+    if (!mRunning)
+        return;
+    mRunning = false;
+    std::chrono::duration<double> d =
+        std::chrono::steady_clock::now() - mStart;
+    time(mStage, d.count());
+}
+
+void profile::time(const char* iStage, double iSeconds)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    Stage& s = stage(iStage);
+    s.calls++;
+    s.seconds += iSeconds;
+}
+
+void profile::count(const char* iStage, int iCounter, long iValue)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    stage(iStage).count[iCounter] += iValue;
+}
+
+/**
+ * Returns a copy of all the stages so far
+ */
+std::map<std::string, profile::Stage> profile::stages()
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    return sStage;
+}
+
+/**
+ * Returns the stages as a JSON object keyed by stage name
+ */
+std::string profile::json()
+{
+    std::map<std::string, Stage> s = stages();
+    std::string ret = "{";
+    char buf[256];
+    for (auto it=s.begin(); it!=s.end(); ++it)
+    {
+        const Stage& t = it->second;
+        std::snprintf(
+            buf, sizeof(buf),
+            "\"calls\": %ld, \"seconds\": %.6g, "
+            "\"frames\": %ld, \"samples\": %ld, \"allocs\": %ld",
+            t.calls, t.seconds,
+            t.count[FRAMES], t.count[SAMPLES], t.count[ALLOCS]
+        );
+        if (it != s.begin())
+            ret += ",";
+        ret += "\n  \"" + it->first + "\": {" + buf + "}";
+    }
+    ret += s.empty() ? "}\n" : "\n}\n";
+    return ret;
+}
+
+void profile::reset()
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    sStage.clear();
+}
+
+/**
+ * True if the library was built to record anything
+ */
+bool profile::enabled()
+{
+#ifdef SSP_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace ssp
+{
+    /**
+     * Per-stage timers and counters.
+     *
+     * Stages are just names.  Each has a call count, the accumulated wall
+     * time, and counters of frames, samples and allocations.  The functions
+     * are always there so a program can query or dump them, but the library
+     * only records anything if built with SSP_PROFILE defined; otherwise the
+     * macros below compile to nothing.
+     */
+    namespace profile
+    {
+        enum {
+            FRAMES,
+            SAMPLES,
+            ALLOCS,
+            NCOUNTERS
+        };
+
+        struct Stage
+        {
+            long calls;
+            double seconds;
+            long count[NCOUNTERS];
+        };
+
+        /**
+         * Scoped timer: adds a call and the time from construction to stop()
+         * or destruction, whichever is first.
+         */
+        class Timer
+        {
+        public:
+            Timer(const char* iStage);
+            ~Timer() { stop(); };
+            void stop();
+        private:
+            const char* mStage;
+            std::chrono::steady_clock::time_point mStart;
+            bool mRunning;
+        };
+
+        void time(const char* iStage, double iSeconds);
+        void count(const char* iStage, int iCounter, long iValue);
+        std::map<std::string, Stage> stages();
+        std::string json();
+        void reset();
+        bool enabled();
+    }
+}
+
+#define SSP_PROFILE_CAT2(a, b) a ## b
+#define SSP_PROFILE_CAT(a, b) SSP_PROFILE_CAT2(a, b)
+
+#ifdef SSP_PROFILE
+/** Times a statement, which may be a declaration, as the given stage */
+# define SSP_PROFILE_TIME(stage, ...)                                     \
+    ssp::profile::Timer SSP_PROFILE_CAT(sspTimer, __LINE__)(stage);     \
+    __VA_ARGS__;                                                        \
+    SSP_PROFILE_CAT(sspTimer, __LINE__).stop()
+/** Adds to one of the counters of a stage */
+# define SSP_PROFILE_COUNT(stage, counter, value)                         \
+    ssp::profile::count(stage, ssp::profile::counter, value)
+#else
+# define SSP_PROFILE_TIME(stage, ...) __VA_ARGS__
+# define SSP_PROFILE_COUNT(stage, counter, value)
+#endif
+
+#endif // PROFILE_H
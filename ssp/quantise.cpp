@@ -0,0 +1,434 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "quantise.h"
+#include "arfile.h"
+
+using namespace ssp;
+using namespace ssp::core;
+
+Codebook::Codebook()
+{
+    mDim = 0;
+    mBits = 0;
+}
+
+/**
+ * Set the size, and optionally the entries
+ */
+void Codebook::set(int iDim, int iBits, const float* iEntry)
+{
+    mDim = iDim;
+    mBits = iBits;
+    if (iEntry)
+        mEntry.assign(iEntry, iEntry + size()*mDim);
+    else
+        mEntry.assign(size()*mDim, 0.0f);
+}
+
+/**
+ * Uniform scalar quantiser with cells spanning iLo to iHi.  For more than
+ * one dimension, each entry is on the diagonal.
+ */
+void Codebook::uniform(float iLo, float iHi)
+{
+    float step = (iHi - iLo) / size();
+    for (int i=0; i<size(); i++)
+        for (int d=0; d<mDim; d++)
+            mEntry[i*mDim+d] = iLo + step * (i + 0.5f);
+}
+
+/**
+ * Nearest entry in the Euclidean sense
+ */
+int Codebook::search(const float* iVector) const
+{
+    return search(iVector, size());
+}
+
+/**
+ * Nearest of the first iSize entries
+ */
+int Codebook::search(const float* iVector, int iSize) const
+{
+    int best = 0;
+    float bestDist = 0.0f;
+    for (int i=0; i<iSize; i++)
+    {
+        const float* e = &mEntry[i*mDim];
+        float dist = 0.0f;
+        for (int d=0; d<mDim; d++)
+        {
+            float x = iVector[d] - e[d];
+            dist += x * x;
+        }
+        if ((i == 0) || (dist < bestDist))
+        {
+            best = i;
+            bestDist = dist;
+        }
+    }
+    return best;
+}
+
+/**
+ * Train by the LBG algorithm: start with the centroid, then repeatedly split
+ * every entry in two and refine with k-means.  Vector n is the mDim values
+ * starting at iData + n*iStride.
+ */
+void Codebook::train(
+    int iNVectors, const float* iData, int iStride, int iIterations
+)
+{
+    if (iNVectors < 1)
+        throw lube::error("Codebook::train: no data");
+    std::vector<float> sum(size()*mDim);
+    std::vector<int> count(size());
+    int n = 1;
+    for (int d=0; d<mDim; d++)
+    {
+        float s = 0.0f;
+        for (int v=0; v<iNVectors; v++)
+            s += iData[v*iStride+d];
+        mEntry[d] = s / iNVectors;
+    }
+    while (n < size())
+    {
+        // Split
+        for (int i=0; i<n; i++)
+            for (int d=0; d<mDim; d++)
+            {
+                float e = mEntry[i*mDim+d];
+                float delta = 1e-3f * std::max(std::abs(e), 1e-3f);
+                mEntry[i*mDim+d] = e - delta;
+                mEntry[(i+n)*mDim+d] = e + delta;
+            }
+        n *= 2;
+
+        // k-means on the first n entries; empty cells keep their entry
+        for (int it=0; it<iIterations; it++)
+        {
+            std::fill(sum.begin(), sum.begin() + n*mDim, 0.0f);
+            std::fill(count.begin(), count.begin() + n, 0);
+            for (int v=0; v<iNVectors; v++)
+            {
+                const float* x = iData + v*iStride;
+                int c = search(x, n);
+                count[c]++;
+                for (int d=0; d<mDim; d++)
+                    sum[c*mDim+d] += x[d];
+            }
+            for (int i=0; i<n; i++)
+                if (count[i])
+                    for (int d=0; d<mDim; d++)
+                        mEntry[i*mDim+d] = sum[i*mDim+d] / count[i];
+        }
+    }
+}
+
+void BitWriter::put(int iValue, int iBits)
+{
+    for (int b=iBits-1; b>=0; --b)
+    {
+        unsigned char mask = 0x80 >> (mBit & 7);
+        if (iValue & (1 << b))
+            mData[mBit >> 3] |= mask;
+        else
+            mData[mBit >> 3] &= ~mask;
+        mBit++;
+    }
+}
+
+int BitReader::get(int iBits)
+{
+    int value = 0;
+    for (int b=0; b<iBits; b++)
+    {
+        int bit = (mData[mBit >> 3] >> (7 - (mBit & 7))) & 1;
+        value = (value << 1) | bit;
+        mBit++;
+    }
+    return value;
+}
+
+
+/*
+ * The bitstream file is a header followed by the packed frames
+ */
+struct bitHeader
+{
+    char magic[4];
+    int version;
+    int order;
+    int nFrames;
+    float rate;
+    float period;
+    int bits;
+    int reserved;
+};
+static const char cMagic[4] = {'S', 'S', 'P', 'B'};
+static const int cVersion = 1;
+static const float cHNRFloor = 1e-8f;
+
+ARQuantiser::ARQuantiser(int iOrder, var iStr)
+    : Config(iStr)
+{
+    mAttr["codebook"] = config("codebook", "");
+    mAttr["lspSplit"] = config("lspSplit", 6);
+    mAttr["lspBits"] = config("lspBits", 10);
+    mAttr["lspScalarBits"] = config("lspScalarBits", 5);
+    mAttr["gainBits"] = config("gainBits", 6);
+    mAttr["f0Bits"] = config("f0Bits", 6);
+    mAttr["hnrBits"] = config("hnrBits", 4);
+    mOrder = iOrder;
+    mNSplits = 0;
+    mRate = 0.0f;
+    if (mAttr["codebook"] != "")
+        load(mAttr["codebook"]);
+    else
+        uniform();
+}
+
+void ARQuantiser::allocate(int iNSplits)
+{
+    mNSplits = iNSplits;
+    mSplit.assign(mNSplits, split());
+}
+
+/**
+ * Untrained default: uniform scalar quantisers over plausible ranges
+ */
+void ARQuantiser::uniform()
+{
+    static const float pi = atan(1.0) * 4;
+    allocate(mOrder+3);
+    for (int i=0; i<mNSplits; i++)
+        mSplit[i].first = i;
+    for (int i=0; i<mOrder; i++)
+    {
+        mSplit[i].book.set(1, mAttr["lspScalarBits"].cast<int>());
+        mSplit[i].book.uniform(0.0f, pi);
+    }
+    mSplit[mOrder+0].book.set(1, mAttr["gainBits"].cast<int>());
+    mSplit[mOrder+0].book.uniform(-30.0f, 2.0f);
+    mSplit[mOrder+1].book.set(1, mAttr["f0Bits"].cast<int>());
+    mSplit[mOrder+1].book.uniform(std::log(40.0f), std::log(500.0f));
+    mSplit[mOrder+2].book.set(1, mAttr["hnrBits"].cast<int>());
+    mSplit[mOrder+2].book.uniform(-10.0f, 10.0f);
+}
+
+/**
+ * Train codebooks on the {lsp, gain, f0, hnr} tuple of ARCodec::encode(),
+ * typically the concatenation of many utterances.  The LSPs are split into
+ * runs of "lspSplit" columns of "lspBits" bits each.
+ */
+void ARQuantiser::train(var iParams)
+{
+    var rows = paramsToRows(iParams);
+    int nFrames = rows.shape(0);
+    int nParams = mOrder+3;
+    if (rows.shape(1) != nParams)
+        throw lube::error("ARQuantiser::train: wrong order");
+    float* r = rows.ptr<float>();
+    for (int f=0; f<nFrames; f++)
+        r[f*nParams+mOrder+2] =
+            std::log(std::max(r[f*nParams+mOrder+2], cHNRFloor));
+
+    int lspSplit = mAttr["lspSplit"].cast<int>();
+    int nLSPSplits = (mOrder + lspSplit - 1) / lspSplit;
+    allocate(nLSPSplits+3);
+    for (int i=0; i<nLSPSplits; i++)
+    {
+        split& s = mSplit[i];
+        s.first = i*lspSplit;
+        s.book.set(
+            std::min(lspSplit, mOrder-s.first), mAttr["lspBits"].cast<int>()
+        );
+    }
+    const char* bits[] = {"gainBits", "f0Bits", "hnrBits"};
+    for (int i=0; i<3; i++)
+    {
+        split& s = mSplit[nLSPSplits+i];
+        s.first = mOrder+i;
+        s.book.set(1, mAttr[bits[i]].cast<int>());
+    }
+    for (int i=0; i<mNSplits; i++)
+        mSplit[i].book.train(nFrames, r + mSplit[i].first, nParams);
+}
+
+/**
+ * The codebook file is text: the number of parameters and splits, then for
+ * each split its first column, dimension, bits and entries.
+ */
+void ARQuantiser::save(var iFile)
+{
+    std::ofstream os(iFile.str());
+    if (os.fail())
+        throw lube::error("ARQuantiser::save: Open failed");
+    os.precision(9);
+    os << mOrder+3 << " " << mNSplits << "\n";
+    for (int i=0; i<mNSplits; i++)
+    {
+        const Codebook& b = mSplit[i].book;
+        os << mSplit[i].first << " " << b.dim() << " " << b.bits() << "\n";
+        for (int e=0; e<b.size(); e++)
+        {
+            for (int d=0; d<b.dim(); d++)
+                os << (d ? " " : "") << b.entry(e)[d];
+            os << "\n";
+        }
+    }
+    if (os.fail())
+        throw lube::error("ARQuantiser::save: Write failed");
+}
+
+void ARQuantiser::load(var iFile)
+{
+    std::ifstream is(iFile.str());
+    if (is.fail())
+        throw lube::error("ARQuantiser::load: Open failed");
+    int nParams;
+    int nSplits;
+    is >> nParams >> nSplits;
+    if (is.fail() || (nParams != mOrder+3) || (nSplits < 1))
+        throw lube::error("ARQuantiser::load: wrong order or format");
+    allocate(nSplits);
+    int column = 0;
+    for (int i=0; i<mNSplits; i++)
+    {
+        int dim;
+        int bits;
+        is >> mSplit[i].first >> dim >> bits;
+        if ( is.fail() || (mSplit[i].first != column) ||
+             (dim < 1) || (bits < 1) || (bits > 24) )
+            throw lube::error("ARQuantiser::load: bad split");
+        column += dim;
+        int n = (1 << bits) * dim;
+        std::vector<float> entry(n);
+        for (int e=0; e<n; e++)
+            is >> entry[e];
+        mSplit[i].book.set(dim, bits, &entry[0]);
+    }
+    if (is.fail() || (column != nParams))
+        throw lube::error("ARQuantiser::load: truncated or short file");
+}
+
+int ARQuantiser::bitsPerFrame() const
+{
+    int bits = 0;
+    for (int i=0; i<mNSplits; i++)
+        bits += mSplit[i].book.bits();
+    return bits;
+}
+
+void ARQuantiser::encode(const float* iRow, BitWriter& ioBits) const
+{
+    float row[mOrder+3];
+    std::memcpy(row, iRow, (mOrder+3)*sizeof(float));
+    row[mOrder+2] = std::log(std::max(row[mOrder+2], cHNRFloor));
+    for (int i=0; i<mNSplits; i++)
+    {
+        const split& s = mSplit[i];
+        ioBits.put(s.book.search(row + s.first), s.book.bits());
+    }
+}
+
+/**
+ * Table lookup, then make sure the LSPs are ordered with a minimum spacing so
+ * the resulting filter is stable.
+ */
+void ARQuantiser::decode(BitReader& ioBits, float* oRow) const
+{
+    static const float pi = atan(1.0) * 4;
+    const float gap = 1e-2f;
+    for (int i=0; i<mNSplits; i++)
+    {
+        const split& s = mSplit[i];
+        const float* e = s.book.entry(ioBits.get(s.book.bits()));
+        std::memcpy(oRow + s.first, e, s.book.dim()*sizeof(float));
+    }
+    float prev = 0.0f;
+    for (int i=0; i<mOrder; i++)
+    {
+        oRow[i] = std::min(std::max(oRow[i], prev + gap), pi - gap);
+        prev = oRow[i];
+    }
+    oRow[mOrder+2] = std::exp(oRow[mOrder+2]);
+}
+
+/**
+ * Write the {lsp, gain, f0, hnr} tuple of ARCodec::encode() as a bitstream
+ */
+void ARQuantiser::write(var iFile, var iParams, float iRate, float iPeriod)
+{
+    var rows = paramsToRows(iParams);
+    int nFrames = rows.shape(0);
+    if (rows.shape(1) != mOrder+3)
+        throw lube::error("ARQuantiser::write: wrong order");
+
+    bitHeader h;
+    std::memcpy(h.magic, cMagic, 4);
+    h.version = cVersion;
+    h.order = mOrder;
+    h.nFrames = nFrames;
+    h.rate = iRate;
+    h.period = iPeriod;
+    h.bits = bitsPerFrame();
+    h.reserved = 0;
+    long nBytes = ((long)nFrames * h.bits + 7) / 8;
+    std::vector<unsigned char> data(nBytes+1, 0);
+    BitWriter bw(&data[0]);
+    float* r = rows.ptr<float>();
+    for (int f=0; f<nFrames; f++)
+        encode(r + f*(mOrder+3), bw);
+
+    std::ofstream os(iFile.str(), std::ofstream::out | std::ofstream::binary);
+    if (!os.fail())
+    {
+        os.write((char*)&h, sizeof(bitHeader));
+        os.write((char*)&data[0], nBytes);
+    }
+    if (os.fail())
+        throw lube::error("ARQuantiser::write: Write failed");
+}
+
+/**
+ * Read a bitstream back into the {lsp, gain, f0, hnr} tuple.  The codebooks
+ * must be the ones it was written with.
+ */
+var ARQuantiser::read(var iFile)
+{
+    std::ifstream is(iFile.str(), std::ifstream::in | std::ifstream::binary);
+    if (is.fail())
+        throw lube::error("ARQuantiser::read: Open failed");
+    bitHeader h;
+    is.read((char*)&h, sizeof(bitHeader));
+    if ( is.fail() || std::memcmp(h.magic, cMagic, 4) ||
+         (h.version != cVersion) || (h.order != mOrder) ||
+         (h.bits != bitsPerFrame()) || (h.nFrames < 0) )
+        throw lube::error("ARQuantiser::read: wrong format or codebooks");
+    mRate = h.rate;
+    long nBytes = ((long)h.nFrames * h.bits + 7) / 8;
+    std::vector<unsigned char> data(nBytes+1, 0);
+    is.read((char*)&data[0], nBytes);
+    if (is.fail())
+        throw lube::error("ARQuantiser::read: Read failed");
+
+    var rows = lube::view({h.nFrames, mOrder+3}, 0.0f);
+    float* r = rows.ptr<float>();
+    BitReader br(&data[0]);
+    for (int f=0; f<h.nFrames; f++)
+        decode(br, r + f*(mOrder+3));
+    return rowsToParams(rows);
+}
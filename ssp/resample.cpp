@@ -0,0 +1,143 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <lube.h>
+#include <lube/c++blas.h>
+#include "resample.h"
+
+using namespace ssp;
+
+/*
+ * Zeroth order modified Bessel function of the first kind, for the Kaiser
+ * window
+ */
+static double bessel0(double iX)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k=1; k<50; k++)
+    {
+        term *= (iX / (2*k)) * (iX / (2*k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+static int gcd(int iA, int iB)
+{
+    while (iB)
+    {
+        int t = iA % iB;
+        iA = iB;
+        iB = t;
+    }
+    return iA;
+}
+
+core::Resampler::Resampler(int iFrom, int iTo, int iTaps)
+{
+    if ((iFrom < 1) || (iTo < 1) || (iTaps < 1))
+        throw lube::error("Resampler: rates and taps must be positive");
+    int g = gcd(iFrom, iTo);
+    mUp = iTo / g;
+    mDown = iFrom / g;
+
+    // The prototype runs at L times the input rate, where the lower rate is
+    // 1/max(L, M).  The transition width of a Kaiser window with beta 8 is
+    // about 5/N of the sample rate, so 5/iTaps at the lower rate.
+    const double beta = 8.0;
+    int r = std::max(mUp, mDown);
+    mTaps = (int)std::ceil((double)iTaps * r / mUp);
+    // The centre is on a tap so that the output is aligned with the input;
+    // if the length is even, the last tap is left at zero.
+    int n = mTaps * mUp;
+    double width = 5.0 / iTaps;
+    double fc = (0.5 - width/2) / r;
+    mDelay = (n-1) / 2;
+    double norm = bessel0(beta);
+    std::vector<double> h(n, 0.0);
+    for (int i=0; i<=mDelay*2; i++)
+    {
+        double t = i - mDelay;
+        double sinc = (t == 0.0)
+            ? 2*fc
+            : std::sin(2*M_PI*fc*t) / (M_PI*t);
+        double x = mDelay ? t / mDelay : 0.0;
+        double w = bessel0(beta * std::sqrt(std::max(0.0, 1.0 - x*x)));
+        h[i] = sinc * w / norm * mUp;
+    }
+
+    // Phase p is taps p, p+L, p+2L, ..., reversed
+    mTable.resize(n);
+    for (int p=0; p<mUp; p++)
+        for (int j=0; j<mTaps; j++)
+            mTable[p*mTaps + mTaps-1-j] = (float)h[p + j*mUp];
+    reset();
+}
+
+void core::Resampler::reset()
+{
+    mBuffer.assign(mTaps-1, 0.0f);
+    mBase = mDelay / mUp;
+    mPhase = mDelay % mUp;
+}
+
+/**
+ * The number of outputs for iNSamples of input, once flushed
+ */
+int core::Resampler::outputs(long iNSamples) const
+{
+    return (int)((iNSamples * mUp + mDown - 1) / mDown);
+}
+
+/**
+ * Resample iNSamples into oSample, which should have room for
+ * outputs(iNSamples) + 1 samples.  Returns the number written.
+ */
+int core::Resampler::operator ()(
+    int iNSamples, const float* iSample, float* oSample
+)
+{
+    // The buffer is the last mTaps-1 samples then the new ones, so output
+    // with base input b is the dot product from buffer index b
+    int h = mTaps-1;
+    mBuffer.resize(h + iNSamples);
+    std::copy(iSample, iSample + iNSamples, mBuffer.begin() + h);
+    float* x = &mBuffer[0];
+    int k = 0;
+    while (mBase < iNSamples)
+    {
+        float* t = &mTable[mPhase*mTaps];
+        oSample[k++] = blas::dot(mTaps, t, x + mBase);
+        mPhase += mDown;
+        mBase += mPhase / mUp;
+        mPhase %= mUp;
+    }
+
+    // Keep what the next call needs
+    mBase -= iNSamples;
+    std::copy(mBuffer.end() - h, mBuffer.end(), mBuffer.begin());
+    mBuffer.resize(h);
+    return k;
+}
+
+/**
+ * Feed enough zeros to complete the outputs that depend on input already
+ * given.  oSample should have room for outputs(taps()) + 1 samples.  Note
+ * that this may give a few more outputs than outputs() counts.
+ */
+int core::Resampler::flush(float* oSample)
+{
+    std::vector<float> zero(mTaps, 0.0f);
+    return operator ()(mTaps, &zero[0], oSample);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <vector>
+
+namespace ssp
+{
+    namespace core
+    {
+        /**
+         * Polyphase sample rate converter from iFrom to iTo Hz, i.e., up by
+         * L and down by M with L/M = iTo/iFrom in lowest terms.
+         *
+         * The low-pass is a Kaiser windowed sinc of iTaps taps at the lower
+         * of the two rates, with its stop band starting at the lower
+         * Nyquist frequency; about 80dB of rejection.  It's held as a table
+         * of L phases, each reversed so each output is a forward dot product
+         * of contiguous arrays, done by blas as in core::Filter.  Only the
+         * phase needed for each output is evaluated.
+         *
+         * It streams: operator() takes any number of input samples and
+         * returns the outputs that are complete, keeping the input it still
+         * needs.  Output k is aligned with input time k*M/L, so the filter
+         * looks ahead; flush() feeds zeros to get out the last ones.
+         */
+        class Resampler
+        {
+        public:
+            Resampler(int iFrom, int iTo, int iTaps=64);
+            int up() const { return mUp; };
+            int down() const { return mDown; };
+            int taps() const { return mTaps; };
+            int outputs(long iNSamples) const;
+            int operator ()(
+                int iNSamples, const float* iSample, float* oSample
+            );
+            int flush(float* oSample);
+            void reset();
+        private:
+            int mUp;
+            int mDown;
+            int mTaps;
+            int mDelay;
+            std::vector<float> mTable;
+            std::vector<float> mBuffer;
+            long mBase;
+            int mPhase;
+        };
+    }
+}
+
+#endif // RESAMPLE_H
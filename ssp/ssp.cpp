@@ -9,10 +9,17 @@
 
 
 #include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
 #include <random>
+#include <atomic>
 
 #include <lube/module.h>
 #include "ssp.h"
+#include "ola.h"
+#include "profile.h"
+#include "resample.h"
 
 using namespace std;
 using namespace ssp;
@@ -29,7 +36,8 @@ PCM::PCM(var iStr)
 
 
 /**
- * Read an audio file
+ * Read an audio file.  If a rate is configured and the file is at another,
+ * the signal is resampled to the configured rate.
  */
 var PCM::read(var iFileName)
 {
@@ -38,7 +46,20 @@ var PCM::read(var iFileName)
     lube::file& sf = sm.create(mAttr);
     var snd = sf.read(iFileName);
     if (rate && (rate != mAttr["rate"]))
-        throw lube::error("read: file rate does not match pcm rate");
+    {
+        if (snd.dim() != 1)
+            throw lube::error("read: can only resample a single channel");
+        core::Resampler r(mAttr["rate"].cast<int>(), rate.cast<int>());
+        mAttr["rate"] = rate;
+        int n = snd.size();
+        int m = r.outputs(n);
+        std::vector<float> y(m + r.outputs(r.taps()) + 2);
+        int k = r(n, snd.ptr<float>(), &y[0]);
+        r.flush(&y[k]);
+        var out(m, 0.0f);
+        std::copy(y.begin(), y.begin() + m, out.ptr<float>());
+        snd = out;
+    }
     return snd;
 }
 
@@ -54,6 +75,325 @@ void PCM::write(var iFileName, var iVar)
 }
 
 
+/*
+ * Little-endian integers from a WAV header
+ */
+static unsigned long wavInt(std::istream& iStream, int iBytes)
+{
+    unsigned char b[4];
+    iStream.read((char*)b, iBytes);
+    if (!iStream)
+        throw lube::error("PCMReader: truncated header");
+    unsigned long ret = 0;
+    for (int i=iBytes-1; i>=0; --i)
+        ret = (ret << 8) | b[i];
+    return ret;
+}
+
+PCMReader::PCMReader(
+    PCM* iPCM, var iFileName, int iBlock, int iOverlap, int iPad
+)
+    : mFile(iFileName.str(), std::ifstream::in | std::ifstream::binary)
+{
+    if ((iBlock < 1) || (iOverlap < 0) || (iOverlap >= iBlock) || (iPad < 0))
+        throw lube::error("PCMReader: bad block, overlap or pad");
+    if (!mFile)
+        throw lube::error("PCMReader: cannot open file");
+    mPCM = iPCM;
+    mBlock = iBlock;
+    mOverlap = iOverlap;
+    mPad = iPad;
+    mPos = 0;
+    mFirst = true;
+
+    // RIFF header, then chunks until the data
+    char id[4];
+    mFile.read(id, 4);
+    wavInt(mFile, 4);
+    char wave[4];
+    mFile.read(wave, 4);
+    if (!mFile || strncmp(id, "RIFF", 4) || strncmp(wave, "WAVE", 4))
+        throw lube::error("PCMReader: not a WAV file");
+    mFormat = 0;
+    mChannels = 0;
+    mAlign = 0;
+    int bits = 0;
+    long rate = 0;
+    for (;;)
+    {
+        mFile.read(id, 4);
+        long size = wavInt(mFile, 4);
+        long next = (long)mFile.tellg() + size + (size & 1);
+        if (!strncmp(id, "fmt ", 4))
+        {
+            mFormat = wavInt(mFile, 2);
+            mChannels = wavInt(mFile, 2);
+            rate = wavInt(mFile, 4);
+            wavInt(mFile, 4);
+            mAlign = wavInt(mFile, 2);
+            bits = wavInt(mFile, 2);
+            if ((mFormat == 0xfffe) && (size >= 26))
+            {
+                // Extensible; the format is at the start of the sub-format
+                wavInt(mFile, 8);
+                mFormat = wavInt(mFile, 2);
+            }
+        }
+        else if (!strncmp(id, "data", 4))
+        {
+            if (!mAlign)
+                throw lube::error("PCMReader: data before format");
+            mData = mFile.tellg();
+            mNFile = size / mAlign;
+            break;
+        }
+        mFile.seekg(next);
+    }
+    bool int16 = (mFormat == 1) && (bits == 16);
+    bool float32 = (mFormat == 3) && (bits == 32);
+    if ((mChannels < 1) || !(int16 || float32))
+        throw lube::error("PCMReader: only 16 bit int or 32 bit float");
+
+    // From here on, samples are at the pcm rate
+    mNSamples = mNFile;
+    int to = (int)mPCM->rate();
+    if (to && (rate != to))
+    {
+        mResampler = std::make_shared<core::Resampler>((int)rate, to);
+        mNSamples = mResampler->outputs(mNFile);
+        mInput.resize(mBlock);
+        mNext = 0;
+        mFed = 0;
+    }
+    else
+        mPCM->mAttr["rate"] = (int)rate;
+
+    mBuffer.resize(mBlock * mAlign);
+    mHead = 0.0f;
+    mTail = 0.0f;
+    mHead16 = 0;
+    mTail16 = 0;
+    if (mNSamples > 0)
+    {
+        load(0, 1, &mHead);
+        load(mNSamples-1, 1, &mTail);
+        if (mFormat == 1)
+        {
+            load(0, 1, &mHead16);
+            load(mNSamples-1, 1, &mTail16);
+        }
+    }
+}
+
+/**
+ * Read iCount samples from sample iStart, at the pcm rate
+ */
+void PCMReader::load(long iStart, long iCount, float* oSample)
+{
+    if (mResampler)
+        resample(iStart, iCount, oSample);
+    else
+        loadFile(iStart, iCount, oSample);
+}
+
+/**
+ * Samples iStart to iStart+iCount of the file resampled to the pcm rate, as
+ * PCM::read() would resample the whole file.  The resampler streams through
+ * the file, so consecutive blocks just carry on.  Going back, or far ahead,
+ * restarts it on an input sample that keeps the outputs on the same grid,
+ * early enough that the outputs from iStart have their full history.
+ */
+void PCMReader::resample(long iStart, long iCount, float* oSample)
+{
+    core::Resampler& r = *mResampler;
+    long ahead = mNext + (long)mPending.size();
+    if ((iStart < mNext) || (iStart > ahead + mBlock))
+    {
+        long in = iStart * r.down() / r.up() - r.taps() - 1;
+        in = std::max<long>(0, in) / r.down() * r.down();
+        r.reset();
+        mFed = in;
+        mNext = in / r.down() * r.up();
+        mPending.clear();
+    }
+
+    // Feed the file, then zeros after it, until the outputs are there
+    while (mNext + (long)mPending.size() < iStart + iCount)
+    {
+        long lo = std::min(mFed, mNFile);
+        long hi = std::min(mFed + mBlock, mNFile);
+        if (hi > lo)
+            loadFile(lo, hi-lo, &mInput[0]);
+        std::fill(mInput.begin() + (hi-lo), mInput.end(), 0.0f);
+        size_t k = mPending.size();
+        mPending.resize(k + r.outputs(mBlock) + 1);
+        int n = r(mBlock, &mInput[0], &mPending[k]);
+        mPending.resize(k + n);
+        mFed += mBlock;
+    }
+    mPending.erase(mPending.begin(), mPending.begin() + (iStart - mNext));
+    mNext = iStart;
+    std::copy(mPending.begin(), mPending.begin() + iCount, oSample);
+}
+
+/**
+ * Read iCount samples from sample iStart of the file, converting to float
+ * and averaging the channels.
+ */
+void PCMReader::loadFile(long iStart, long iCount, float* oSample)
+{
+    mFile.clear();
+    mFile.seekg(mData + iStart * mAlign);
+    while (iCount > 0)
+    {
+        long n = std::min<long>(iCount, mBlock);
+        mFile.read(&mBuffer[0], n * mAlign);
+        if (!mFile)
+            throw lube::error("PCMReader: truncated data");
+        for (long i=0; i<n; i++)
+        {
+            float sum = 0.0f;
+            const char* b = &mBuffer[i * mAlign];
+            for (int c=0; c<mChannels; c++)
+                if (mFormat == 1)
+                {
+                    int16_t x;
+                    memcpy(&x, b + c*2, 2);
+                    sum += x / 32768.0f;
+                }
+                else
+                {
+                    float x;
+                    memcpy(&x, b + c*4, 4);
+                    sum += x;
+                }
+            oSample[i] = sum / mChannels;
+        }
+        oSample += n;
+        iCount -= n;
+    }
+}
+
+/**
+ * Read iCount 16 bit samples from sample iStart of a 16 bit file, as they
+ * are; channels are averaged, rounding towards zero.  Resampled samples are
+ * rounded back to 16 bits.
+ */
+void PCMReader::load(long iStart, long iCount, int16_t* oSample)
+{
+    if (mResampler)
+    {
+        std::vector<float> x(iCount);
+        resample(iStart, iCount, &x[0]);
+        for (long i=0; i<iCount; i++)
+        {
+            float v = std::round(x[i] * 32768.0f);
+            oSample[i] = (int16_t)std::min(std::max(v, -32768.0f), 32767.0f);
+        }
+        return;
+    }
+    mFile.clear();
+    mFile.seekg(mData + iStart * mAlign);
+    while (iCount > 0)
+    {
+        long n = std::min<long>(iCount, mBlock);
+        mFile.read(&mBuffer[0], n * mAlign);
+        if (!mFile)
+            throw lube::error("PCMReader: truncated data");
+        for (long i=0; i<n; i++)
+        {
+            int sum = 0;
+            const char* b = &mBuffer[i * mAlign];
+            for (int c=0; c<mChannels; c++)
+            {
+                int16_t x;
+                memcpy(&x, b + c*2, 2);
+                sum += x;
+            }
+            oSample[i] = (int16_t)(sum / mChannels);
+        }
+        oSample += n;
+        iCount -= n;
+    }
+}
+
+/**
+ * Where the next block starts in the file (negative in the padding) and its
+ * length; moves on to the block after.  Returns false when there are no more
+ * samples.
+ */
+bool PCMReader::next(long& oStart, int& oLen)
+{
+    long total = mNSamples + 2*mPad;
+    if ((mNSamples == 0) || (mPos >= total) ||
+        (!mFirst && (mPos + mOverlap >= total)))
+        return false;
+    oLen = std::min<long>(mBlock, total - mPos);
+    oStart = mPos - mPad;
+    mPos += mBlock - mOverlap;
+    mFirst = false;
+    return true;
+}
+
+/**
+ * Fill a block of iLen samples from iStart: samples of the file, then the
+ * padding around them.
+ */
+template <class T>
+void PCMReader::fill(long iStart, int iLen, T iHead, T iTail, T* oBlock)
+{
+    long lo = std::max<long>(0, iStart);
+    long hi = std::min<long>(mNSamples, iStart + iLen);
+    if (hi > lo)
+        load(lo, hi-lo, oBlock + (lo-iStart));
+    for (long i=0; i<std::min<long>(iLen, lo-iStart); i++)
+        oBlock[i] = iHead;
+    for (long i=std::max<long>(0, hi-iStart); i<iLen; i++)
+        oBlock[i] = iTail;
+}
+
+/**
+ * Read the next block into oBlock, resizing it if necessary.  Returns false
+ * when there are no more samples.
+ */
+bool PCMReader::read(var& oBlock)
+{
+    long start;
+    int len;
+    if (!next(start, len))
+        return false;
+    if (oBlock.size() != len)
+        oBlock = var(len, 0.0f);
+    fill(start, len, mHead, mTail, oBlock.ptr<float>());
+    return true;
+}
+
+/**
+ * Read the next block of a 16 bit file into oBlock as the samples
+ * themselves, i.e., Q15, with no conversion to float.  Returns false when
+ * there are no more samples.
+ */
+bool PCMReader::read(std::vector<int16_t>& oBlock)
+{
+    if (mFormat != 1)
+        throw lube::error("PCMReader::read: not a 16 bit file");
+    long start;
+    int len;
+    if (!next(start, len))
+        return false;
+    oBlock.resize(len);
+    fill(start, len, mHead16, mTail16, &oBlock[0]);
+    return true;
+}
+
+void PCMReader::seek(var iSeconds)
+{
+    // Position is in the padded signal, so this is iPad before the time
+    mPos = std::max(0, mPCM->secondsToSamples(iSeconds, PCM::EXACT));
+    mFirst = true;
+}
+
+
 var PCM::frame(var iVar, int iSize, int iPeriod, bool iPad)
 {
     if (iPad)
@@ -100,14 +440,16 @@ float PCM::dftBinToHz(var iBin)
 }
 
 /**
- * Returns a number of samples corresponding to the given time.  If iPower is
- * AT_LEAST then it is rounded up to the next power of 2; AT_MOST rounds down
- * to the previous power of 2.
+ * Returns a number of samples corresponding to the given time.  EXACT gives
+ * the count itself, without rounding.  AT_MOST rounds down to the previous
+ * power of 2, as does the default if the count isn't one already.  Beware
+ * that AT_LEAST, being 0, has always given the count itself too, and the
+ * codec relies on that; the rounding up is never reached.
  */
 int PCM::secondsToSamples(var iSeconds, ind iPower)
 {
     int samples = iSeconds.cast<float>() * rate();
-    if (!iPower)
+    if (!iPower || (iPower == EXACT))
         return samples;
 
     int s = 1;
@@ -139,6 +481,35 @@ var Codec::decode(var iParams)
     throw lube::error("No decoder defined");
 }
 
+namespace
+{
+    std::atomic<long> sScratchAllocs(0);
+}
+
+var Scratch::get(int iSlot, var iShape, var iType)
+{
+    if (iSlot >= (int)mSlot.size())
+        mSlot.resize(iSlot+1);
+    var& v = mSlot[iSlot];
+    bool fits = v.size() && (v.atype() == iType.atype()) &&
+        (v.dim() == iShape.size());
+    for (int i=0; fits && (i<iShape.size()); i++)
+        if (v.shape(i) != iShape[i].get<int>())
+            fits = false;
+    if (!fits)
+    {
+        v = lube::view(iShape, iType);
+        sScratchAllocs++;
+        SSP_PROFILE_COUNT("Scratch", ALLOCS, 1);
+    }
+    return v;
+}
+
+long Scratch::allocs()
+{
+    return sScratchAllocs;
+}
+
 Frame::Frame(int iSize, int iPeriod, bool iPad)
     : UnaryFunctor(iSize)
 {
@@ -146,21 +517,71 @@ Frame::Frame(int iSize, int iPeriod, bool iPad)
     mPad = iPad;
 }
 
-var Frame::alloc(var iVar) const
+/**
+ * The number of frames that a signal of iNSamples will be framed into
+ */
+int Frame::frames(int iNSamples) const
 {
-    var sh = iVar.shape();
-    int n = sh.top().get<int>();
+    int n = iNSamples;
     if (mPad)
         n += mSize;
-    int nFrames = (n - (mSize-mPeriod)) / mPeriod;
+    return (n - (mSize-mPeriod)) / mPeriod;
+}
+
+var Frame::alloc(var iVar) const
+{
+    var sh = iVar.shape();
+    int nFrames = frames(sh.top().get<int>());
     sh[sh.size()-1] = nFrames;
     sh.push(mSize);
     var ret = lube::view(sh, iVar.at(0));
     return ret;
 }
 
+/**
+ * Frames of iX, of iNSamples, as if padded by iSize/2 copies of the first
+ * and last samples.  The padding is never built; samples beyond the ends
+ * just read the end samples.
+ */
+template <class T>
+static void framePadded(
+    const T* iX, int iNSamples, T* oFrame, int iNFrames, int iSize,
+    int iPeriod
+)
+{
+    for (int r=0; r<iNFrames; r++)
+    {
+        int beg = r*iPeriod - iSize/2;
+        T* o = oFrame + r*iSize;
+        int lo = std::max(0, -beg);
+        int hi = std::max(lo, std::min(iSize, iNSamples-beg));
+        for (int i=0; i<lo; i++)
+            o[i] = iX[0];
+        std::memcpy(o+lo, iX+beg+lo, (hi-lo)*sizeof(T));
+        for (int i=hi; i<iSize; i++)
+            o[i] = iX[iNSamples-1];
+    }
+}
+
 void Frame::vector(var iVar, var& oVar) const
 {
+    int nFrames = oVar.shape(oVar.dim()-2);
+    if (mPad && (iVar.atype() == lube::TYPE_FLOAT))
+    {
+        framePadded<float>(
+            iVar.ptr<float>(), iVar.size(), oVar.ptr<float>(),
+            nFrames, mSize, mPeriod
+        );
+        return;
+    }
+    if (mPad && (iVar.atype() == lube::TYPE_DOUBLE))
+    {
+        framePadded<double>(
+            iVar.ptr<double>(), iVar.size(), oVar.ptr<double>(),
+            nFrames, mSize, mPeriod
+        );
+        return;
+    }
     if (mPad)
     {
         // This ensures that frames are aligned in the centre.  Awfully.
@@ -173,7 +594,6 @@ void Frame::vector(var iVar, var& oVar) const
 
     var f = oVar.view({mSize});
     var g = iVar.view({mSize});
-    int nFrames = oVar.shape(oVar.dim()-2);
     for (int r=0; r<nFrames; r++)
     {
         f = g;
@@ -278,22 +698,80 @@ var ssp::BinaryFunctor::alloc(var iVar1, var iVar2) const
 }
 
 AutocorrelationP::AutocorrelationP(int iSize)
-    : UnaryFunctor(iSize), mDFT(iSize), mIDFT(iSize)
-{}
+    : UnaryFunctor(iSize)
+{
+    mDim = 2;
+}
 
-void AutocorrelationP::scalar(const var& iVar, var& oVar) const
+void AutocorrelationP::vector(var iVar, var& oVar) const
 {
-    // Lube's IDFT has a division by N.  Still need to normalise the
-    // autocorrelation though.
-    var tmp = mDFT(iVar);
-    tmp.norm();
-    tmp /= mSize;
-    mIDFT(tmp, oVar);
+    int n = iVar.shape(iVar.dim()-1);
+    if (mSize > n)
+        throw lube::error("AutocorrelationP: more lags than frame size");
+
+    // Pad to a power of 2 of at least 2n-1 so the lags don't wrap around
+    int pad = 2;
+    while (pad < 2*n-1)
+        pad *= 2;
+    const core::RealFFT& fft = fftPlan(pad);
+
+    // Run the frames through in blocks to bound the scratch space
+    int nFrames = iVar.size() / n;
+    int nc = pad/2+1;
+    int block = std::min(nFrames, 64);
+    float* real = mScratch.get(0, {block*pad}).ptr<float>();
+    float* spec = mScratch.get(1, {block*nc*2}).ptr<float>();
+    float* iv = iVar.ptr<float>();
+    float* ov = oVar.ptr<float>();
+    for (int f=0; f<nFrames; f+=block)
+    {
+        int nb = std::min(block, nFrames-f);
+        for (int b=0; b<nb; b++)
+        {
+            float* r = real + b*pad;
+            std::memcpy(r, iv + (f+b)*n, n*sizeof(float));
+            std::memset(r+n, 0, (pad-n)*sizeof(float));
+        }
+        fft.forward(nb, real, spec);
+        for (int k=0; k<nb*nc; k++)
+        {
+            float re = spec[k*2];
+            float im = spec[k*2+1];
+            spec[k*2] = (re*re + im*im) / n;
+            spec[k*2+1] = 0.0f;
+        }
+        fft.inverse(nb, spec, real);
+        for (int b=0; b<nb; b++)
+            std::memcpy(
+                ov + (f+b)*mSize, real + b*pad, mSize*sizeof(float)
+            );
+    }
 }
 
-Autocorrelation::Autocorrelation(int iSize)
+Autocorrelation::Autocorrelation(int iSize, bool iMixed)
     : UnaryFunctor(iSize)
-{}
+{
+    mMixed = iMixed;
+}
+
+/**
+ * Direct autocorrelation of type T accumulated in type A
+ */
+template <class T, class A>
+static void autocorrelation(int iSize, int iLags, const T* iData, T* oLag)
+{
+    int p = iLags-1;
+    int np = iSize - p;
+    for (int i=0; i<iLags; i++)
+    {
+        // Dot product; could be optimised.  And note that autocorrelation is
+        // normalised by definition.
+        A sum = 0;
+        for (int j=iSize-1; j>=p; j--)
+            sum += (A)iData[j] * (A)iData[j-i];
+        oLag[i] = (T)(sum / np);
+    }
+}
 
 void
 Autocorrelation::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
@@ -303,30 +781,51 @@ Autocorrelation::vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const
     // s = input vector size
     // mSize = output vector size = order + 1
     int n = iVar.shape(iVar.dim()-1);
-    int p = mSize-1;
-    int np = n - p;
-    if (np < 1)
+    if (n - (mSize-1) < 1)
         throw lube::error("Autocorrelation: order too large for vector size");
-    float* iv = iVar.ptr<float>(iOffsetI);
-    float* ov = oVar.ptr<float>(iOffsetO);
-    for (int i=0; i<mSize; i++)
+    switch (iVar.atype())
     {
-        // Dot product; could be optimised.  And note that autocorrelation is
-        // normalised by definition.
-        float sum = 0.0f;
-        for (int j=n-1; j>=p; j--)
-            sum += iv[j] * iv[j-i];
-        ov[i] = sum / np;
+    case lube::TYPE_FLOAT:
+        if (mMixed)
+            autocorrelation<float, double>(
+                n, mSize, iVar.ptr<float>(iOffsetI), oVar.ptr<float>(iOffsetO)
+            );
+        else
+            autocorrelation<float, float>(
+                n, mSize, iVar.ptr<float>(iOffsetI), oVar.ptr<float>(iOffsetO)
+            );
+        break;
+    case lube::TYPE_DOUBLE:
+        autocorrelation<double, double>(
+            n, mSize, iVar.ptr<double>(iOffsetI), oVar.ptr<double>(iOffsetO)
+        );
+        break;
+    default:
+        throw lube::error("Autocorrelation::vector: unknown type");
     }
 }
 
+OverlapAdd::OverlapAdd(int iPeriod, var iWindow, bool iNormalise)
+{
+    mDim = 2;
+    mPeriod = iPeriod;
+    mWindow = iWindow;
+    mNormalise = iNormalise;
+}
+
+int OverlapAdd::period(var iVar) const
+{
+    return mPeriod ? mPeriod : iVar.shape(iVar.dim()-1) / 2;
+}
+
 var OverlapAdd::alloc(var iVar) const
 {
     if (iVar.dim() < 2)
         throw lube::error("OverlapAdd::alloc: dimension less than 2");
     var sh = iVar.shape();
-    int step = sh.pop().get<int>() / 2;
-    int size = (sh.top().get<int>() + 1) * step;
+    int step = period(iVar);
+    int frameSize = sh.pop().get<int>();
+    int size = (sh.top().get<int>() - 1) * step + frameSize;
     sh[sh.size()-1] = size;
     var ret = lube::view(sh, iVar.at(0));  // Doesn't initialise!  Should it?
     return ret;
@@ -334,13 +833,14 @@ var OverlapAdd::alloc(var iVar) const
 
 void OverlapAdd::vector(var iVar, var& oVar) const
 {
-    // This can surely be vectorised
-    int step = iVar.shape(1) / 2;
-    for (int i=0; i<oVar.size(); i++)
-        oVar(i) = 0.0f;
-    for (int f=0; f<iVar.shape(0); f++)
-        for (int s=0; s<iVar.shape(1); s++)
-            oVar(f*step+s) += iVar(f,s);
+    int frameSize = iVar.shape(1);
+    if (mWindow.size() && (mWindow.size() != frameSize))
+        throw lube::error("OverlapAdd::vector: window is the wrong size");
+    core::OverlapAdd ola(
+        frameSize, period(iVar),
+        mWindow.size() ? mWindow.ptr<float>() : 0, mNormalise
+    );
+    ola(iVar.shape(0), iVar.ptr<float>(), oVar.ptr<float>());
 }
 
 
@@ -11,10 +11,16 @@
 #define SSP_H
 
 
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <fstream>
 #include <lube.h>
 #include <lube/dft.h>
 #include <lube/config.h>
 #include "filter.h"
+#include "fft.h"
+#include "resample.h"
 
 namespace ssp
 {
@@ -34,7 +40,8 @@ namespace ssp
 
         enum {
             AT_LEAST,
-            AT_MOST
+            AT_MOST,
+            EXACT
         };
 
         var read(var iFileName);
@@ -47,10 +54,95 @@ namespace ssp
         int secondsToSamples(var iSeconds, ind iPower=-1);
         float samplesToSeconds(var iSamples);
     private:
+        friend class PCMReader;
         var mAttr;
     };
 
 
+    /**
+     * Reads a WAV file a block at a time, so a file of any length can be
+     * analysed in constant memory.  Each block is iBlock samples (the last
+     * may be shorter), and consecutive blocks share iOverlap samples.  With
+     * iPad, the signal is padded at each end by repeating the end samples,
+     * as Frame does.  So, Frame(size, period) of the whole signal is the
+     * same as Frame(size, period, false) of each block given iPad = size/2,
+     * iOverlap = size - period and iBlock = iOverlap + n*period.
+     *
+     * seek() moves to a time; the next block starts iPad samples before it,
+     * so the first frame as above is centred on it.  Multi-channel files are
+     * averaged to mono.  16 bit integer and 32 bit float samples are
+     * understood, in the byte order of the host, i.e., little-endian.  A 16
+     * bit file can also be read into int16 blocks, untouched, for the fixed
+     * point kernels of fixed.h.
+     *
+     * If the pcm has a rate and the file is at another, the file is
+     * resampled as it's read, giving the samples that PCM::read() would.
+     * Blocks, samples() and seek() are then all at the pcm rate, and int16
+     * blocks are the resampled samples rounded.
+     */
+    class PCMReader
+    {
+    public:
+        PCMReader(
+            PCM* iPCM, var iFileName, int iBlock, int iOverlap=0, int iPad=0
+        );
+        bool read(var& oBlock);
+        bool read(std::vector<int16_t>& oBlock);
+        void seek(var iSeconds);
+        long samples() const { return mNSamples; };
+    private:
+        bool next(long& oStart, int& oLen);
+        template <class T>
+        void fill(long iStart, int iLen, T iHead, T iTail, T* oBlock);
+        void load(long iStart, long iCount, float* oSample);
+        void load(long iStart, long iCount, int16_t* oSample);
+        void loadFile(long iStart, long iCount, float* oSample);
+        void resample(long iStart, long iCount, float* oSample);
+        PCM* mPCM;
+        std::ifstream mFile;
+        int mFormat;
+        int mChannels;
+        int mAlign;
+        long mData;
+        long mNFile;
+        long mNSamples;
+        int mBlock;
+        int mOverlap;
+        int mPad;
+        long mPos;
+        bool mFirst;
+        float mHead;
+        float mTail;
+        int16_t mHead16;
+        int16_t mTail16;
+        std::vector<char> mBuffer;
+        std::shared_ptr<core::Resampler> mResampler;
+        std::vector<float> mInput;
+        std::vector<float> mPending;
+        long mNext;
+        long mFed;
+    };
+
+
+    /**
+     * Reusable scratch arrays for objects that are called repeatedly.  get()
+     * returns the array in a numbered slot, reallocating it only when the
+     * shape or element type differs from last time, so once the sizes
+     * settle the slots themselves allocate nothing.  The contents are
+     * overwritten by the next user of the slot.  allocs() counts the
+     * (re)allocations of slots over all instances; it knows nothing of
+     * allocations elsewhere, e.g., inside lube.  ssp-bench counts those.
+     */
+    class Scratch
+    {
+    public:
+        var get(int iSlot, var iShape, var iType=0.0f);
+        static long allocs();
+    private:
+        std::vector<var> mSlot;
+    };
+
+
     /**
      * Abstract codec class
      */
@@ -99,34 +191,42 @@ namespace ssp
 
 
     /**
-     * Autocorrelation using periodogram method
+     * Autocorrelation using periodogram method.  Frames are zero padded so
+     * the result is the linear (not circular) autocorrelation normalised by
+     * the frame size.  Only the first iSize lags are returned.  Frames are
+     * transformed in batches, so this is the fast path for many lags.  The
+     * batch buffers are kept between calls, so an instance is for one
+     * thread at a time.
      */
     class AutocorrelationP : public UnaryFunctor
     {
     public:
         AutocorrelationP(int iSize);
     protected:
-        void scalar(const var& iVar, var& oVar) const;
+        void vector(var iVar, var& oVar) const;
     private:
-        lube::DFT mDFT;
-        lube::IDFT mIDFT;
+        mutable Scratch mScratch;
     };
 
     /**
-     * Autocorrelation using direct method
+     * Autocorrelation using direct method.  Float or double; with iMixed,
+     * float input is accumulated in double.
      */
     class Autocorrelation : public UnaryFunctor
     {
     public:
-        Autocorrelation(int iSize);
+        Autocorrelation(int iSize, bool iMixed=false);
     protected:
         void vector(var iVar, ind iOffsetI, var& oVar, ind iOffsetO) const;
+    private:
+        bool mMixed;
     };
 
     class Frame : public UnaryFunctor
     {
     public:
         Frame(int iSize, int iPeriod, bool iPad=true);
+        int frames(int iNSamples) const;
     protected:
         var alloc(var iVar) const;
         void vector(var iVar, var& oVar) const;
@@ -135,15 +235,30 @@ namespace ssp
         bool mPad;
     };
 
+    /**
+     * Overlap-add of [nFrames, size] frames.  The period defaults to half
+     * the frame size.  See core::OverlapAdd for the window and
+     * normalisation, and for streaming.
+     */
     class OverlapAdd : public lube::UnaryFunctor
     {
     public:
-        OverlapAdd() { mDim = 2; };
+        OverlapAdd(
+            int iPeriod=0, var iWindow=lube::nil, bool iNormalise=false
+        );
     protected:
         var alloc(var iVar) const;
         void vector(var iVar, var& oVar) const;
+    private:
+        int period(var iVar) const;
+        int mPeriod;
+        var mWindow;
+        bool mNormalise;
     };
 
+    /**
+     * IIR filter over core::Filter; float only
+     */
     class Filter : public lube::UnaryFunctor
     {
     public:
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <lube.h>
+#include "vad.h"
+
+using namespace ssp;
+
+core::VAD::VAD(float iThreshold, float iFlatness, int iHangover)
+{
+    mThreshold = iThreshold;
+    mFlatness = iFlatness;
+    mHangover = iHangover;
+}
+
+/*
+ * Prediction gain in dB of an order 2 AR model on normalised lags; 0 for
+ * white noise, big for a peaky spectrum
+ */
+static float predictionGain(const float* iAC)
+{
+    float r1 = iAC[1] / iAC[0];
+    float r2 = iAC[2] / iAC[0];
+    float e1 = 1.0f - r1*r1;
+    if (e1 <= 1e-6f)
+        return 60.0f;
+    float k2 = (r2 - r1*r1) / e1;
+    float e2 = e1 * (1.0f - k2*k2);
+    return -10.0f * std::log10(std::max(e2, 1e-6f));
+}
+
+/**
+ * Fill oMask with 1 for speech and 0 for silence; returns the number of
+ * speech frames.
+ */
+int core::VAD::operator ()(
+    int iNFrames, int iLags, const float* iAC, float* oMask
+) const
+{
+    // Log energies; the floor is the 10th percentile of those that aren't
+    // digital silence.  If not even the loudest frame is clear of the floor
+    // by the threshold, there's no silence to speak of, so it's all speech.
+    std::vector<float> energy(iNFrames);
+    std::vector<float> sorted;
+    sorted.reserve(iNFrames);
+    for (int i=0; i<iNFrames; i++)
+    {
+        float e = iAC[i*iLags];
+        energy[i] = (e > 0.0f) ? 10.0f * std::log10(e) : -HUGE_VALF;
+        if (e > 0.0f)
+            sorted.push_back(energy[i]);
+    }
+    float floor = HUGE_VALF;
+    bool all = false;
+    if (sorted.size() > 0)
+    {
+        std::vector<float>::iterator p = sorted.begin() + sorted.size() / 10;
+        std::nth_element(sorted.begin(), p, sorted.end());
+        floor = *p;
+        all = (*std::max_element(p, sorted.end()) - floor < mThreshold);
+    }
+
+    // Threshold, with the flatness rescuing quieter voiced frames, then the
+    // hangover
+    int nSpeech = 0;
+    int hold = 0;
+    for (int i=0; i<iNFrames; i++)
+    {
+        float d = energy[i] - floor;
+        bool speech = all || (d > mThreshold);
+        if (!speech && (iLags >= 3) && (d > mThreshold * 0.5f))
+            speech = predictionGain(iAC + i*iLags) > mFlatness;
+        if (speech)
+            hold = mHangover + 1;
+        if (energy[i] == -HUGE_VALF)
+            hold = 0;
+        oMask[i] = (hold > 0) ? 1.0f : 0.0f;
+        if (hold > 0)
+        {
+            nSpeech++;
+            hold--;
+        }
+    }
+    return nSpeech;
+}
+
+ssp::VAD::VAD(float iThreshold, float iFlatness, int iHangover)
+    : mVAD(iThreshold, iFlatness, iHangover)
+{
+    mDim = 2;
+}
+
+var ssp::VAD::alloc(var iVar) const
+{
+    // One value per frame
+    var sh = iVar.shape();
+    sh.pop();
+    return lube::view(sh, iVar.at(0));
+}
+
+void ssp::VAD::vector(var iVar, var& oVar) const
+{
+    mVAD(iVar.shape(0), iVar.shape(1), iVar.ptr<float>(), oVar.ptr<float>());
+}
+
+int ssp::compact(var iMask, var iVar, var oVar)
+{
+    int nRows = iVar.shape(0);
+    int size = iVar.size() / nRows;
+    float* m = iMask.ptr<float>();
+    float* x = iVar.ptr<float>();
+    float* o = oVar.ptr<float>();
+    int j = 0;
+    for (int i=0; i<nRows; i++)
+        if (m[i] > 0.0f)
+            std::memcpy(o + size*j++, x + size*i, size*sizeof(float));
+    return j;
+}
+
+void ssp::expand(var iMask, var iVar, var oVar)
+{
+    int nRows = oVar.shape(0);
+    int size = oVar.size() / nRows;
+    float* m = iMask.ptr<float>();
+    float* x = iVar.ptr<float>();
+    float* o = oVar.ptr<float>();
+    int j = 0;
+    for (int i=0; i<nRows; i++)
+        if (m[i] > 0.0f)
+            std::memcpy(o + size*i, x + size*j++, size*sizeof(float));
+}
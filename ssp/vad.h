@@ -0,0 +1,75 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef VAD_H
+#define VAD_H
+
+#include "ssp.h"
+
+namespace ssp
+{
+    namespace core
+    {
+        /**
+         * Voice activity detection on frame autocorrelations, as from
+         * Autocorrelation; lag 0 is the frame energy.  The noise floor is
+         * the 10th percentile of the log energies in the call.  If even the
+         * loudest frame is within iThreshold dB of it, nothing stands out
+         * from the floor, and every frame is speech.  Otherwise, a frame is
+         * speech if its energy is iThreshold dB above the floor, or half
+         * that and it is not spectrally flat, i.e., the prediction gain of
+         * an order 2 AR model (which needs 3 lags) is over iFlatness dB.
+         * Each speech frame then holds the following iHangover frames on.
+         * Frames of digital silence are never speech.
+         */
+        class VAD
+        {
+        public:
+            VAD(float iThreshold=9.0f, float iFlatness=3.0f,
+                int iHangover=10);
+            int operator ()(
+                int iNFrames, int iLags, const float* iAC, float* oMask
+            ) const;
+        private:
+            float mThreshold;
+            float mFlatness;
+            int mHangover;
+        };
+    }
+
+    /**
+     * Voice activity detector; see core::VAD.  Takes [nFrames, lags] of
+     * autocorrelation (at least one lag) and gives a [nFrames] mask that is
+     * 1 for speech and 0 otherwise.
+     */
+    class VAD : public lube::UnaryFunctor
+    {
+    public:
+        VAD(float iThreshold=9.0f, float iFlatness=3.0f, int iHangover=10);
+    protected:
+        var alloc(var iVar) const;
+        void vector(var iVar, var& oVar) const;
+    private:
+        core::VAD mVAD;
+    };
+
+    /**
+     * Copy the rows of iVar where iMask is set to the first rows of oVar,
+     * which must be big enough; returns the number of rows copied.
+     */
+    int compact(var iMask, var iVar, var oVar);
+
+    /**
+     * The inverse of compact(): the first rows of iVar go to the rows of
+     * oVar where iMask is set.  The other rows are untouched.
+     */
+    void expand(var iMask, var iVar, var oVar);
+}
+
+#endif // VAD_H
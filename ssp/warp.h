@@ -10,43 +10,121 @@
 #ifndef WARP_H
 #define WARP_H
 
+#include <cmath>
+#include <string>
+
 namespace ssp
 {
-    float hzToERB(float iHz)
+    inline float hzToERB(float iHz)
     {
         float erb = 24.7f * (4.37e-3*iHz + 1.0f);
         return erb;
     }
 
-    float erbToHz(float iERB)
+    inline float erbToHz(float iERB)
     {
         float hz = (iERB/24.7f-1.0f) / 4.37e-3;
         return hz;
     }
 
-    float hzToERBRate(float iHz)
+    inline float hzToERBRate(float iHz)
     {
         float rate = 21.4f * std::log10(4.37e-3f * iHz + 1);
         return rate;
     }
 
-    float erbRateToHz(float iRate)
+    inline float erbRateToHz(float iRate)
     {
         float hz = (std::pow(10, iRate / 21.4f) - 1.0f) / 4.37e-3f;
         return hz;
     }
 
     /** Convert a value in Hz to the mel scale. */
-    float hzToMel(float iHz)
+    inline float hzToMel(float iHz)
     {
         return 2595.0f * std::log10(1.0f + iHz / 700.0f);
     }
 
     /** Convert a value from the mel scale to Hz. */
-    float melToHz(float iMel)
+    inline float melToHz(float iMel)
     {
         return 700.0f * (std::pow(10, iMel / 2595.0f) - 1.0f);
     }
+
+    /**
+     * Convert a value in Hz to the Bark scale, after Traunmuller (1990).
+     */
+    inline float hzToBark(float iHz)
+    {
+        return 26.81f * iHz / (1960.0f + iHz) - 0.53f;
+    }
+
+    /** Convert a value from the Bark scale to Hz. */
+    inline float barkToHz(float iBark)
+    {
+        return 1960.0f * (iBark + 0.53f) / (26.28f - iBark);
+    }
+
+    /**
+     * Frequency scales that can be selected at run time.  WARP_LOG needs a
+     * positive lower frequency.
+     */
+    enum {
+        WARP_MEL,
+        WARP_ERB,
+        WARP_BARK,
+        WARP_LINEAR,
+        WARP_LOG
+    };
+
+    /** Convert a value in Hz to the given scale. */
+    inline float hzToWarp(int iScale, float iHz)
+    {
+        switch (iScale)
+        {
+        case WARP_ERB:
+            return hzToERBRate(iHz);
+        case WARP_BARK:
+            return hzToBark(iHz);
+        case WARP_LINEAR:
+            return iHz;
+        case WARP_LOG:
+            return std::log(iHz);
+        default:
+            return hzToMel(iHz);
+        }
+    }
+
+    /** Convert a value on the given scale to Hz. */
+    inline float warpToHz(int iScale, float iWarp)
+    {
+        switch (iScale)
+        {
+        case WARP_ERB:
+            return erbRateToHz(iWarp);
+        case WARP_BARK:
+            return barkToHz(iWarp);
+        case WARP_LINEAR:
+            return iWarp;
+        case WARP_LOG:
+            return std::exp(iWarp);
+        default:
+            return melToHz(iWarp);
+        }
+    }
+
+    /**
+     * The scale with the given name: "mel", "erb", "bark", "linear" or
+     * "log"; -1 if there is no such scale.
+     */
+    inline int warpScale(const std::string& iName)
+    {
+        const char* name[] = {"mel", "erb", "bark", "linear", "log"};
+        for (int i=0; i<5; i++)
+            if (iName == name[i])
+                return i;
+        return -1;
+    }
 }
 
 #endif // WARP_H
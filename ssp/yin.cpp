@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <algorithm>
+#include <lube.h>
+#include "yin.h"
+
+using namespace ssp;
+
+core::DifferencePitch::DifferencePitch(
+    int iSize, int iPeriod, int iMinLag, int iMaxLag, float iThreshold
+)
+{
+    if ((iSize < 1) || (iPeriod < 1))
+        throw lube::error("DifferencePitch: size and period must be positive");
+    if ((iMinLag < 1) || (iMaxLag <= iMinLag))
+        throw lube::error("DifferencePitch: invalid lag range");
+    mSize = iSize;
+    mPeriod = iPeriod;
+    mMinLag = iMinLag;
+    mMaxLag = iMaxLag;
+    mThreshold = iThreshold;
+    mDiff.resize(mMaxLag+1);
+    mNorm.resize(mMaxLag+1);
+}
+
+/**
+ * Adds (or, with iSign negative, subtracts) samples [iFrom, iTo) of the
+ * signal to the difference function.
+ */
+void core::DifferencePitch::update(
+    const float* iSignal, int iFrom, int iTo, double iSign
+)
+{
+    for (int t=1; t<=mMaxLag; t++)
+    {
+        double sum = 0.0;
+        for (int j=iFrom; j<iTo; j++)
+        {
+            double d = iSignal[j] - iSignal[j+t];
+            sum += d * d;
+        }
+        mDiff[t] += iSign * sum;
+    }
+}
+
+/**
+ * Normalises by the cumulative mean, then takes the first dip below the
+ * threshold in the lag range, else the global minimum.  The minimum is
+ * refined by parabolic interpolation.
+ */
+void core::DifferencePitch::pick(float& oLag, float& oAperiodicity)
+{
+    double cum = 0.0;
+    mNorm[0] = 1.0f;
+    for (int t=1; t<=mMaxLag; t++)
+    {
+        double d = mDiff[t] > 0.0 ? mDiff[t] : 0.0;
+        cum += d;
+        mNorm[t] = cum > 0.0 ? (float)(d * t / cum) : 1.0f;
+    }
+
+    int best = mMinLag;
+    for (int t=mMinLag; t<mMaxLag; t++)
+    {
+        if (mNorm[t] < mThreshold)
+        {
+            while ((t+1 < mMaxLag) && (mNorm[t+1] < mNorm[t]))
+                t++;
+            best = t;
+            break;
+        }
+        if (mNorm[t] < mNorm[best])
+            best = t;
+    }
+
+    float lag = best;
+    float a = mNorm[best-1];
+    float b = mNorm[best];
+    float c = mNorm[best+1];
+    float den = a - 2.0f*b + c;
+    if (den > 0.0f)
+    {
+        float delta = 0.5f * (a - c) / den;
+        if ((delta > -1.0f) && (delta < 1.0f))
+            lag += delta;
+    }
+    oLag = lag;
+    oAperiodicity = b;
+}
+
+void core::DifferencePitch::operator ()(
+    int iNFrames, const float* iSignal, float* oLag, float* oAperiodicity
+)
+{
+    for (int r=0; r<iNFrames; r++)
+    {
+        int start = r * mPeriod;
+        if ((r == 0) || (mPeriod >= mSize))
+        {
+            std::fill(mDiff.begin(), mDiff.end(), 0.0);
+            update(iSignal, start, start+mSize, 1.0);
+        }
+        else
+        {
+            // Slide the window along by one period
+            int prev = start - mPeriod;
+            update(iSignal, prev, start, -1.0);
+            update(iSignal, prev+mSize, start+mSize, 1.0);
+        }
+        pick(oLag[r], oAperiodicity[r]);
+    }
+}
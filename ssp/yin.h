@@ -0,0 +1,65 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef YIN_H
+#define YIN_H
+
+#include <vector>
+
+namespace ssp
+{
+    namespace core
+    {
+        /**
+         * Pitch by the cumulative mean normalised difference function of
+         * YIN (de Cheveigne & Kawahara, 2002).
+         *
+         * The difference function d(t) = sum (x[j] - x[j+t])^2 is summed
+         * over a window of iSize samples that moves by iPeriod each frame.
+         * Rather than recompute each frame, the samples leaving the window
+         * are subtracted and those entering are added, so the cost per frame
+         * is proportional to iPeriod rather than iSize.  The sums are in
+         * double to keep the drift down.
+         *
+         * operator() does iNFrames frames, frame r being the window starting
+         * at iSignal + r*iPeriod; the signal must extend iMaxLag samples past
+         * the last window.  The outputs are the (interpolated) lag and the
+         * aperiodicity, which is the normalised difference at that lag: near
+         * 0 for periodic frames, near 1 for noise.
+         */
+        class DifferencePitch
+        {
+        public:
+            DifferencePitch(
+                int iSize, int iPeriod, int iMinLag, int iMaxLag,
+                float iThreshold=0.1f
+            );
+            int length(int iNFrames) const
+            {
+                return iNFrames ? (iNFrames-1) * mPeriod + mSize + mMaxLag : 0;
+            };
+            void operator()(
+                int iNFrames, const float* iSignal,
+                float* oLag, float* oAperiodicity
+            );
+        private:
+            void update(const float* iSignal, int iFrom, int iTo, double iSign);
+            void pick(float& oLag, float& oAperiodicity);
+            int mSize;
+            int mPeriod;
+            int mMinLag;
+            int mMaxLag;
+            float mThreshold;
+            std::vector<double> mDiff;
+            std::vector<float> mNorm;
+        };
+    }
+}
+
+#endif // YIN_H
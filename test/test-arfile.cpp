@@ -0,0 +1,171 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cmath>
+#include <lube.h>
+#include "ssp/ssp.h"
+#include "ssp/arfile.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Largest difference of each column of iRows from the rows of the mapped
+ * file, relative to the range of that column in iRows
+ */
+static float rowDiff(var iRows, const ARFile& iFile)
+{
+    int nFrames = iRows.shape(0);
+    int nParams = iRows.shape(1);
+    if ( (iFile.info().nFrames != nFrames) ||
+         (iFile.info().order+3 != nParams) )
+        return 1e30f;
+    float* pa = iRows.ptr<float>();
+    float r[nParams];
+    float lo[nParams];
+    float hi[nParams];
+    float d[nParams];
+    for (int p=0; p<nParams; p++)
+    {
+        lo[p] = pa[p];
+        hi[p] = pa[p];
+        d[p] = 0.0f;
+    }
+    for (int f=0; f<nFrames; f++)
+    {
+        iFile.frame(f, r);
+        for (int p=0; p<nParams; p++)
+        {
+            lo[p] = min(lo[p], pa[f*nParams+p]);
+            hi[p] = max(hi[p], pa[f*nParams+p]);
+            d[p] = max(d[p], abs(pa[f*nParams+p] - r[p]));
+        }
+    }
+    float ret = 0.0f;
+    for (int p=0; p<nParams; p++)
+        ret = max(ret, d[p] / (hi[p] - lo[p]));
+    return ret;
+}
+
+/*
+ * Whether read() gave the rows of the mapped file
+ */
+static bool readMatch(var iParams, const ARFile& iFile)
+{
+    var rows = paramsToRows(iParams);
+    int nFrames = rows.shape(0);
+    int nParams = rows.shape(1);
+    float* pr = rows.ptr<float>();
+    float r[nParams];
+    bool same = true;
+    for (int f=0; f<nFrames; f++)
+    {
+        iFile.frame(f, r);
+        for (int p=0; p<nParams; p++)
+            same = same && (abs(r[p] - pr[f*nParams+p]) < 1e-5f);
+    }
+    return same;
+}
+
+/*
+ * Whether open() rejects iFile with one header field changed by iEdit
+ */
+template <class F>
+static bool rejects(var iFile, F iEdit)
+{
+    std::ifstream is(iFile.str(), std::ifstream::binary);
+    std::vector<char> buf(
+        (std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()
+    );
+    ARFile::header h;
+    std::memcpy(&h, &buf[0], sizeof(h));
+    iEdit(h);
+    std::memcpy(&buf[0], &h, sizeof(h));
+    std::ofstream os("test-bad.arc", std::ofstream::binary);
+    os.write(&buf[0], buf.size());
+    os.close();
+    ARFile bad;
+    try
+    {
+        bad.open("test-bad.arc");
+    }
+    catch (...)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    const int nFrames = 50;
+    const int order = 18;
+    const float rate = 16000.0f;
+    const float period = 0.005f;
+    var x = params(nFrames, order);
+
+    // Float rows should come back exactly, and quantised ones to within
+    // the rounding of a 16 bit step of the range of each column
+    lube::Config cnf;
+    cnf.configFile(TEST_DIR "/test-arfile.ini");
+    var rows = paramsToRows(x);
+    ARFile af;
+    ARFile aq("ARFileQ");
+    af.write("test-float.arc", x, rate, period);
+    aq.write("test-quant.arc", x, rate, period);
+    var yf = af.read("test-float.arc");
+    var yq = aq.read("test-quant.arc");
+    const char* name[] = {"Float", "Quantised"};
+    ARFile* file[] = {&af, &aq};
+    var y[] = {yf, yq};
+    int bits[] = {32, 16};
+    float tol[] = {0.0f, 4.0f / 65535};
+    for (int i=0; i<2; i++)
+    {
+        const ARFile::header& h = file[i]->info();
+        bool hdr = (h.order == order) && (h.nFrames == nFrames) &&
+            (h.rate == rate) && (h.period == period) && (h.bits == bits[i]);
+        cout << name[i] << ": header " << (hdr ? "match" : "differ")
+             << ", rows "
+             << (rowDiff(rows, *file[i]) <= tol[i] ? "match" : "differ")
+             << ", read "
+             << (readMatch(y[i], *file[i]) ? "match" : "differ") << endl;
+    }
+
+    // Headers that don't fit the file are rejected
+    typedef ARFile::header H;
+    bool reject =
+        !rejects("test-quant.arc", [](H&) {}) &&
+        rejects("test-quant.arc", [](H& h) { h.order = -1; }) &&
+        rejects("test-quant.arc", [](H& h) { h.nFrames = -1; }) &&
+        rejects("test-quant.arc", [](H& h) { h.nFrames = 1 << 30; }) &&
+        rejects("test-quant.arc", [](H& h) { h.bits = 8; }) &&
+        rejects("test-quant.arc", [](H& h) { h.offset = sizeof(H); }) &&
+        rejects("test-quant.arc", [](H& h) { h.offset = 1 << 30; });
+    cout << "Bad headers: " << (reject ? "rejected" : "accepted") << endl;
+
+    // Oracle parameters have an excitation rather than pitch
+    bool oracle = false;
+    try
+    {
+        paramsToRows({x[0], x[1], lube::view({nFrames, 160}, 0.0f)});
+    }
+    catch (...)
+    {
+        oracle = true;
+    }
+    cout << "Oracle rows: " << (oracle ? "rejected" : "accepted") << endl;
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "ssp/ssp.h"
+#include "ssp/cochlea.h"
+#include "ssp/warp.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Block versus sample by sample processing of the cochleas.  They should be
+ * the same to rounding, and across block boundaries.
+ */
+
+// Deterministic noise in +/-0.5
+static void noise(int iSize, float* oSample, unsigned int iSeed=1)
+{
+    unsigned int x = iSeed;
+    for (int i=0; i<iSize; i++)
+        oSample[i] = 0.5f * noise(x);
+}
+
+static float compare(Cochlea& iSerial, Cochlea& iBlock, int iNFilters)
+{
+    const int nSamples = 2048;
+    const int split = 700;
+    float x[nSamples];
+    noise(nSamples, x);
+    float* s = new float[nSamples*iNFilters];
+    float* b = new float[nSamples*iNFilters];
+    for (int t=0; t<nSamples; t++)
+        iSerial(x[t], s + t*iNFilters);
+    iBlock(split, x, b);
+    iBlock(nSamples-split, x+split, b + split*iNFilters);
+    float err = 0.0f;
+    for (int i=0; i<nSamples*iNFilters; i++)
+        err = max(err, abs(s[i] - b[i]) / (abs(s[i]) + 1e-3f));
+    delete [] s;
+    delete [] b;
+    return err;
+}
+
+/*
+ * The envelope by hand from the full rate output
+ */
+static float envelope(Cochlea& iFull, Cochlea& iEnv, int iNFilters, int& oN)
+{
+    const int nSamples = 2048;
+    const int decimate = 160;
+    const int taps = decimate*2;
+    const float compress = 0.3f;
+    float x[nSamples];
+    noise(nSamples, x);
+    float* full = new float[nSamples*iNFilters];
+    iFull(nSamples, x, full);
+    float w[taps];
+    float sum = 0.0f;
+    for (int i=0; i<taps; i++)
+        sum += w[i] = 0.5f - 0.5f * cos(2.0f * PI * (i+0.5f) / taps);
+
+    iEnv.decimate(decimate, compress);
+    float* env = new float[nSamples/decimate*iNFilters];
+    oN = iEnv.envelope(700, x, env);
+    oN += iEnv.envelope(nSamples-700, x+700, env + oN*iNFilters);
+
+    float err = 0.0f;
+    for (int f=0; f<oN; f++)
+        for (int k=0; k<iNFilters; k++)
+        {
+            int t = (f+1)*decimate - 1;
+            float e = 0.0f;
+            for (int i=0; (i<taps) && (t-i>=0); i++)
+            {
+                float v = max(full[(t-i)*iNFilters+k], 0.0f);
+                e += w[i] / sum * pow(v, compress);
+            }
+            float d = env[f*iNFilters+k];
+            err = max(err, abs(e - d) / (abs(e) + 1e-3f));
+        }
+    delete [] full;
+    delete [] env;
+    return err;
+}
+
+/*
+ * Streams in a multi-stream filterbank versus one instance per stream.  Three
+ * streams start; at the split one leaves and eight more join, so a lane is
+ * reused and the lanes grow.
+ */
+template <class M, class S>
+static float multi(int iNFilters, float iPeriod)
+{
+    const int nSamples = 1024;
+    const int split = 300;
+    const int nStreams = 11;
+    float x[nStreams][nSamples];
+    for (int s=0; s<nStreams; s++)
+        noise(nSamples, x[s], s+1);
+
+    M m(100, 0.5f/iPeriod, iNFilters, iPeriod);
+    S* ref[nStreams];
+    int lane[nStreams];
+    int start[nStreams];
+    for (int s=0; s<nStreams; s++)
+    {
+        ref[s] = new S(100, 0.5f/iPeriod, iNFilters, iPeriod);
+        start[s] = (s < 3) ? 0 : split;
+        lane[s] = (s < 3) ? m.add() : -1;
+    }
+
+    float err = 0.0f;
+    int seg[3] = {0, split, nSamples};
+    for (int g=0; g<2; g++)
+    {
+        if (g == 1)
+        {
+            m.remove(lane[1]);
+            lane[1] = -1;
+            for (int s=3; s<nStreams; s++)
+                lane[s] = m.add();
+        }
+        int n = seg[g+1] - seg[g];
+        int nl = m.lanes();
+        float* in = new float[n*nl];
+        float* out = new float[n*iNFilters*nl];
+        for (int i=0; i<n*nl; i++)
+            in[i] = 0.0f;
+        for (int s=0; s<nStreams; s++)
+            if (lane[s] >= 0)
+                for (int t=0; t<n; t++)
+                    in[t*nl+lane[s]] = x[s][seg[g]+t-start[s]];
+        m.process(n, in, out);
+        float r[iNFilters];
+        for (int s=0; s<nStreams; s++)
+            if (lane[s] >= 0)
+                for (int t=0; t<n; t++)
+                {
+                    (*ref[s])(x[s][seg[g]+t-start[s]], r);
+                    for (int k=0; k<iNFilters; k++)
+                    {
+                        float d = out[(t*iNFilters+k)*nl+lane[s]];
+                        err = max(err, abs(r[k] - d) / (abs(r[k]) + 1e-3f));
+                    }
+                }
+        delete [] in;
+        delete [] out;
+    }
+    for (int s=0; s<nStreams; s++)
+        delete ref[s];
+    return err;
+}
+
+/*
+ * Filterbanks built concurrently, after one of another type, versus one from
+ * a shared design.  The design used to depend on static state.
+ */
+static float design(int iNFilters, float iPeriod)
+{
+    const int nThreads = 4;
+    const int nSamples = 256;
+    float x[nSamples];
+    noise(nSamples, x);
+    Holdsworth h(100, 0.5f/iPeriod, iNFilters, iPeriod);
+    Lyon l(100, 0.5f/iPeriod, iNFilters, iPeriod);
+    std::shared_ptr<const CochleaDesign> d =
+        l.design(100, 0.5f/iPeriod, iNFilters, iPeriod);
+    std::vector<float> out[nThreads+1];
+    std::vector<std::thread> worker;
+    for (int i=0; i<=nThreads; i++)
+    {
+        out[i].resize(nSamples*iNFilters);
+        worker.push_back(std::thread([&, i]{
+            if (i == nThreads)
+            {
+                Lyon c(*d);
+                c(nSamples, x, &out[i][0]);
+            }
+            else
+            {
+                Lyon c(100, 0.5f/iPeriod, iNFilters, iPeriod);
+                c(nSamples, x, &out[i][0]);
+            }
+        }));
+    }
+    for (int i=0; i<=nThreads; i++)
+        worker[i].join();
+    float err = 0.0f;
+    for (int i=0; i<nThreads; i++)
+        for (int j=0; j<nSamples*iNFilters; j++)
+            err = max(err, abs(out[i][j] - out[nThreads][j]));
+    return err;
+}
+
+/*
+ * Each scale should give increasing centre frequencies inside the range, and
+ * the same design twice should be the same object.
+ */
+static int scales(int iNFilters, float iPeriod, bool& oShared)
+{
+    Lyon l(100, 0.5f/iPeriod, iNFilters, iPeriod);
+    int nGood = 0;
+    for (int s=WARP_MEL; s<=WARP_LOG; s++)
+    {
+        std::shared_ptr<const CochleaDesign> d =
+            l.design(100, 0.5f/iPeriod, iNFilters, iPeriod, s);
+        bool good = (d->scale == s) && (d->centre[0] > 100);
+        for (int i=1; i<iNFilters; i++)
+            good = good && (d->centre[i] > d->centre[i-1]);
+        good = good && (d->centre[iNFilters-1] < 0.5f/iPeriod);
+        if (good)
+            nGood++;
+    }
+    oShared = (
+        l.design(100, 0.5f/iPeriod, iNFilters, iPeriod, WARP_BARK) ==
+        l.design(100, 0.5f/iPeriod, iNFilters, iPeriod, WARP_BARK)
+    );
+    return nGood;
+}
+
+/*
+ * The bandwidth scale of a gammatone of order iOrder:
+ *   a_n = pi (2n-2)! 2^-(2n-2) / ((n-1)!)^2
+ */
+static double an(int iOrder)
+{
+    double num = 1.0;
+    for (int k=2; k<=2*iOrder-2; k++)
+        num *= k;
+    double den = 1.0;
+    for (int k=2; k<=iOrder-1; k++)
+        den *= k;
+    return atan(1.0) * 4 * num / pow(2.0, 2*iOrder-2) / (den*den);
+}
+
+/*
+ * Coefficients of a Lyon (order 2) and a Cascade (order 1) against their
+ * closed forms, built after a Holdsworth (order 4).  The bandwidth scale
+ * used to be static, so was that of whichever filterbank came first.
+ */
+static void closedForm(
+    int iNFilters, float iPeriod, float& oLyon, float& oCascade
+)
+{
+    const double pi = atan(1.0) * 4;
+    float hi = 0.5f/iPeriod;
+    Holdsworth h(100, hi, iNFilters, iPeriod);
+    Cascade c(100, hi, iNFilters, iPeriod);
+    Lyon l(100, hi, iNFilters, iPeriod);
+    std::shared_ptr<const CochleaDesign> dl =
+        l.design(100, hi, iNFilters, iPeriod);
+    std::shared_ptr<const CochleaDesign> dc =
+        c.design(100, hi, iNFilters, iPeriod);
+    oLyon = 0.0f;
+    oCascade = 0.0f;
+    for (int i=0; i<iNFilters; i++)
+    {
+        double hz = dl->centre[i];
+        double E = exp(-2*pi*hzToERB(hz)*iPeriod / an(2));
+        double C = cos(2*pi*hz*iPeriod);
+        double ref[3] = {1 - E*C*2 + E*E, E*C*2, -E*E};
+        for (int k=0; k<3; k++)
+            oLyon = max(oLyon, (float)abs(dl->coeff[i*3+k] - ref[k]));
+    }
+    for (int i=0; i<iNFilters-1; i++)
+    {
+        double hz = dc->centre[i];
+        double zHz = dc->centre[i+1];
+        double Ep = exp(-2*pi*hzToERB(hz)*iPeriod / an(1));
+        double Cp = cos(2*pi*hz*iPeriod);
+        double Ez = exp(-2*pi*hzToERB(zHz)*iPeriod / an(1));
+        double Cz = cos(2*pi*zHz*iPeriod);
+        double A = (1 - Ep*Cp*2 + Ep*Ep) / (1 - Ez*Cz*2 + Ez*Ez);
+        double ref[5] = {A, -A*Ez*Cz*2, A*Ez*Ez, Ep*Cp*2, -Ep*Ep};
+        for (int k=0; k<5; k++)
+            oCascade = max(oCascade, (float)abs(dc->coeff[i*5+k] - ref[k]));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    float rate = 16000;
+    float period = 1.0f/rate;
+    int nFilters = 32;
+
+    // First, so that nothing else has been built
+    float lyonErr;
+    float cascadeErr;
+    closedForm(nFilters, period, lyonErr, cascadeErr);
+    cout << "Closed form: Lyon "
+         << (lyonErr < 1e-4f ? "match" : "differ") << ", Cascade "
+         << (cascadeErr < 1e-4f ? "match" : "differ") << endl;
+
+    Cascade cs(100, rate/2, nFilters, period);
+    Cascade cb(100, rate/2, nFilters, period);
+    float err = compare(cs, cb, nFilters);
+    cout << "Cascade: " << (err < 1e-5f ? "match" : "differ") << endl;
+
+    Lyon ls(100, rate/2, nFilters, period);
+    Lyon lb(100, rate/2, nFilters, period);
+    lb.threads(3);
+    err = compare(ls, lb, nFilters);
+    cout << "Lyon: " << (err < 1e-5f ? "match" : "differ") << endl;
+
+    Cascade cf(100, rate/2, nFilters, period);
+    Cascade ce(100, rate/2, nFilters, period);
+    int nEnv;
+    err = envelope(cf, ce, nFilters, nEnv);
+    cout << "Envelope: " << nEnv << " frames, "
+         << (err < 1e-4f ? "match" : "differ") << endl;
+
+    err = multi<MultiLyon, Lyon>(nFilters, period);
+    cout << "MultiLyon: " << (err < 1e-5f ? "match" : "differ") << endl;
+    err = multi<MultiCascade, Cascade>(nFilters, period);
+    cout << "MultiCascade: " << (err < 1e-5f ? "match" : "differ") << endl;
+
+    err = design(nFilters, period);
+    cout << "Design: " << (err == 0.0f ? "match" : "differ") << endl;
+
+    bool shared;
+    int nScales = scales(nFilters, period, shared);
+    cout << "Scales: " << nScales << " good, "
+         << (shared ? "shared" : "not shared") << endl;
+
+    return 0;
+}
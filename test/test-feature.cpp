@@ -0,0 +1,196 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include "ssp/delta.h"
+#include "ssp/feature.h"
+#include "ssp/htk.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Each weight of a (linear) filterbank, by putting a unit impulse in each
+ * bin, against the dense triangle.  Between the first and last centres the
+ * triangles should sum to one.
+ */
+static void filterbank(
+    int iNFilters, int iNBins, int iScale, float& oErr, float& oSum
+)
+{
+    PCM pcm;
+    FilterbankFeatures fb(&pcm, iNFilters, iNBins, 0.0f, 0.0f, iScale, false);
+    var spec = lube::view({iNBins, iNBins}, 0.0f);
+    float* ps = spec.ptr<float>();
+    for (int k=0; k<iNBins; k++)
+        ps[k*iNBins+k] = 1.0f;
+    var w = fb(spec);
+    float* pw = w.ptr<float>();
+
+    float nyquist = pcm.rate() / 2;
+    float lo = hzToWarp(iScale, 0.0f);
+    float step = (hzToWarp(iScale, nyquist) - lo) / (iNFilters+1);
+    oErr = 0.0f;
+    oSum = 0.0f;
+    for (int k=0; k<iNBins; k++)
+    {
+        float hz = nyquist * k / (iNBins-1);
+        float wk = hzToWarp(iScale, hz);
+        float sum = 0.0f;
+        for (int m=0; m<iNFilters; m++)
+        {
+            float d = std::abs(wk - (lo + step*(m+1))) / step;
+            float ref = (d < 1.0f) ? 1.0f - d : 0.0f;
+            oErr = std::max(oErr, std::abs(pw[k*iNFilters+m] - ref));
+            sum += pw[k*iNFilters+m];
+        }
+        if ((hz >= fb.centre(0)) && (hz <= fb.centre(iNFilters-1)))
+            oSum = std::max(oSum, std::abs(sum - 1.0f));
+    }
+}
+
+/*
+ * True if the filterbank refuses the band edges
+ */
+static bool rejected(float iLoHz, float iHiHz)
+{
+    PCM pcm;
+    try
+    {
+        FilterbankFeatures fb(&pcm, 26, 257, iLoHz, iHiHz);
+    }
+    catch (...)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    std::cout.precision(4);
+
+    // A quadratic in the first parameter, linear in the second
+    const int nFrames = 7;
+    const int nParams = 2;
+    float x[nFrames*nParams];
+    for (int t=0; t<nFrames; t++)
+    {
+        x[t*nParams+0] = t*t;
+        x[t*nParams+1] = t;
+    }
+
+    // Whole matrix
+    core::Delta delta(nParams, 2);
+    float d[nFrames*nParams];
+    delta(nFrames, x, d);
+    cout << "Delta:";
+    for (int i=0; i<nFrames*nParams; i++)
+        cout << " " << d[i];
+    cout << endl;
+
+    // Streamed in chunks of three frames should be identical
+    float s[nFrames*nParams];
+    int n = 0;
+    for (int t=0; t<nFrames; t+=3)
+    {
+        int c = (t+3 > nFrames) ? nFrames-t : 3;
+        n += delta.push(c, x+t*nParams, s+n*nParams);
+    }
+    n += delta.flush(s+n*nParams);
+    cout << "Streamed: " << n << " frames";
+    for (int i=0; i<nFrames*nParams; i++)
+        if (s[i] != d[i])
+            cout << ", differs at " << i;
+    cout << endl;
+
+    // Filterbank weights on both scales, and the kind with and without log
+    const char* scaleName[] = {"mel", "erb"};
+    int scale[] = {WARP_MEL, WARP_ERB};
+    for (int i=0; i<2; i++)
+    {
+        float err;
+        float sum;
+        filterbank(26, 257, scale[i], err, sum);
+        cout << "Filterbank " << scaleName[i] << ": "
+             << ((err < 1e-5f) ? "match" : "differ") << ", "
+             << ((sum < 1e-5f) ? "unity" : "not unity") << endl;
+    }
+    PCM pcm;
+    FilterbankFeatures fbLog(&pcm, 26, 257);
+    FilterbankFeatures fbLin(&pcm, 26, 257, 0.0f, 0.0f, WARP_MEL, false);
+    cout << "Filterbank kind: "
+         << ((fbLog.kind() == HTK_FBANK) && (fbLin.kind() == HTK_MELSPEC)
+             ? "match" : "differ") << endl;
+    float nyquist = pcm.rate() / 2;
+    cout << "Filterbank edges: "
+         << ((rejected(0.0f, nyquist*2) && rejected(1000.0f, 500.0f) &&
+              !rejected(100.0f, nyquist))
+             ? "checked" : "unchecked") << endl;
+
+    // Front ends on the test file, framed at 25 ms every 10 ms.  The default
+    // is MFCC with energy; the PLP section adds deltas and accelerations.
+    lube::Config cnf;
+    cnf.configFile(TEST_DIR "/test-feature.ini");
+    var a = pcm.read(TEST_DIR "/test.wav");
+    Frame frame(400, 160);
+    int nFramed = frame(a).shape(0);
+    FrontEnd mfcc(&pcm);
+    FrontEnd plp(&pcm, "PLP");
+    FrontEnd* fe[] = {&mfcc, &plp};
+    const char* feName[] = {"MFCC", "PLP"};
+    int feKind[] = {HTK_MFCC | HTK_E, HTK_PLP | HTK_E | HTK_D | HTK_A};
+    for (int i=0; i<2; i++)
+    {
+        var x = fe[i]->extract(a);
+        float* px = x.ptr<float>();
+        bool finite = true;
+        for (int j=0; j<x.size(); j++)
+            finite = finite && std::isfinite(px[j]);
+        cout << feName[i] << ": " << x.shape(1) << " columns, "
+             << ((x.shape(0) == nFramed) ? "all" : "wrong") << " frames, "
+             << ((fe[i]->kind() == feKind[i]) ? "kind match" : "kind differ")
+             << ", " << (finite ? "finite" : "not finite") << endl;
+    }
+    cout << "Period: " << mfcc.period() << endl;
+
+    // With VAD, quiet copies of the file in between loud ones are dropped,
+    // but the rows that are left are as without VAD, deltas and all
+    FrontEnd vplp(&pcm, "VAD");
+    int na = a.size();
+    var y = lube::view({na*4}, 0.0f);
+    float* pa = a.ptr<float>();
+    float* py = y.ptr<float>();
+    for (int j=0; j<na*4; j++)
+        py[j] = pa[j % na] * (((j / na) % 2) ? 1.0f : 0.001f);
+    var full = plp.extract(y);
+    var speech = vplp.extract(y);
+    int nCols = full.shape(1);
+    int nFull = full.shape(0);
+    int nSpeech = speech.size() ? speech.shape(0) : 0;
+    float* pf = full.ptr<float>();
+    float* psp = speech.ptr<float>();
+    int r = 0;
+    for (int t=0; (t<nFull) && (r<nSpeech); t++)
+    {
+        bool same = true;
+        for (int j=0; j<nCols; j++)
+            same = same && (std::abs(pf[t*nCols+j] - psp[r*nCols+j]) <=
+                            1e-4f * (1.0f + std::abs(pf[t*nCols+j])));
+        if (same)
+            r++;
+    }
+    cout << "VAD: "
+         << ((nSpeech > 0) && (nSpeech < nFull) ? "dropped" : "kept")
+         << ", " << ((r == nSpeech) ? "rows match" : "rows differ") << endl;
+
+    // Done
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include <lube.h>
+#include <lube/dft.h>
+#include "ssp/fft.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * A batch of noise frames through the bundled backend against lube's DFT,
+ * relative to the biggest bin, and back through the bundled inverse.  Sizes
+ * that aren't powers of 2 fall back to lube, so should match exactly.
+ */
+static void compare(int iSize, float& oForward, float& oRoundTrip)
+{
+    const int nFrames = 3;
+    int nBins = iSize/2+1;
+    var x = lube::view({nFrames, iSize}, 0.0f);
+    float* px = x.ptr<float>();
+    for (int i=0; i<nFrames*iSize; i++)
+        px[i] = noise();
+
+    lube::DFT dft(iSize);
+    RealDFT rdft(iSize, FFT_BUNDLED);
+    RealIDFT ridft(iSize, FFT_BUNDLED);
+    var ref = dft(x);
+    var y = rdft(x);
+    var z = ridft(y);
+    lube::cfloat* pr = ref.ptr<lube::cfloat>();
+    lube::cfloat* py = y.ptr<lube::cfloat>();
+    float* pz = z.ptr<float>();
+    float peak = 0.0f;
+    oForward = 0.0f;
+    for (int i=0; i<nFrames*nBins; i++)
+    {
+        peak = max(peak, abs(pr[i]));
+        oForward = max(oForward, abs(py[i] - pr[i]));
+    }
+    oForward /= peak;
+    oRoundTrip = 0.0f;
+    for (int i=0; i<nFrames*iSize; i++)
+        oRoundTrip = max(oRoundTrip, abs(pz[i] - px[i]));
+}
+
+int main(int argc, char** argv)
+{
+    int size[] = {2, 8, 64, 512, 4096, 400};
+    for (int i=0; i<6; i++)
+    {
+        float fwd;
+        float rt;
+        compare(size[i], fwd, rt);
+        cout << size[i] << ": "
+             << (fwd < 1e-5f ? "match" : "differ") << ", round trip "
+             << (rt < 1e-5f ? "match" : "differ") << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include "ssp/ssp.h"
+#include "ssp/fixed.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Fixed point kernels versus float (well, double) references
+ */
+
+// Resonant noise at about half scale; something like a vowel
+static void signal(int iSize, int16_t* oSample)
+{
+    unsigned int x = 1;
+    double y1 = 0.0;
+    double y2 = 0.0;
+    for (int i=0; i<iSize; i++)
+    {
+        double y = noise(x) * 1000 + 1.8 * y1 - 0.9 * y2;
+        y2 = y1;
+        y1 = y;
+        oSample[i] = (int16_t)std::max(-32768.0, std::min(32767.0, y));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int nSamples = 4000;
+    const int size = 400;
+    const int period = 160;
+    const int order = 12;
+    int16_t s[nSamples];
+    signal(nSamples, s);
+
+    // Framing with the conversion fused in
+    int nFrames = core::frames(nSamples, size, period);
+    float window[size];
+    int16_t windowQ15[size];
+    for (int i=0; i<size; i++)
+    {
+        window[i] = 0.54f - 0.46f * cos(2.0f * M_PI * i / (size-1));
+        windowQ15[i] = (int16_t)lround(window[i] * 32767);
+    }
+    float* f = new float[nFrames*size];
+    int16_t* q = new int16_t[nFrames*size];
+    core::frame(nSamples, s, size, period, window, f);
+    core::frameQ15(nSamples, s, size, period, windowQ15, q);
+    float frameErr = 0.0f;
+    for (int r=0; r<nFrames; r++)
+        for (int t=0; t<size; t++)
+        {
+            int i = std::max(0, std::min(nSamples-1, r*period + t - size/2));
+            float ref = s[i] / 32768.0f * window[t];
+            frameErr = max(frameErr, abs(f[r*size+t] - ref));
+            frameErr = max(frameErr, abs(q[r*size+t] / 32768.0f - ref));
+        }
+    cout << "Frames: " << nFrames << ", "
+         << (frameErr < 1e-4f ? "match" : "differ") << endl;
+
+    // Autocorrelation and Levinson per frame
+    float acErr = 0.0f;
+    float arErr = 0.0f;
+    for (int r=0; r<nFrames; r++)
+    {
+        const int16_t* x = q + r*size;
+        double ac[order+1];
+        for (int i=0; i<=order; i++)
+        {
+            double sum = 0.0;
+            for (int j=size-1; j>=order; j--)
+                sum += x[j] / 32768.0 * x[j-i] / 32768.0;
+            ac[i] = sum / (size-order);
+        }
+        int32_t acQ31[order+1];
+        int shift = core::autocorrelationQ15(size, order+1, x, acQ31);
+        for (int i=0; i<=order; i++)
+        {
+            double v = ldexp((double)acQ31[i], -(30+shift)) / (size-order);
+            acErr = max(acErr, (float)(abs(v - ac[i]) / ac[0]));
+        }
+
+        double a[order+1];
+        double p[order+1];
+        a[0] = p[0] = 1.0;
+        double error = ac[0];
+        for (int i=1; i<=order; i++)
+        {
+            for (int j=0; j<i; j++)
+                p[j] = a[j];
+            double k = ac[i];
+            for (int j=1; j<i; j++)
+                k += p[j] * ac[i-j];
+            a[i] = -k / error;
+            error *= 1.0 - a[i]*a[i];
+            for (int j=1; j<i; j++)
+                a[j] = p[j] + a[i] * p[i-j];
+        }
+        int32_t arQ24[order+1];
+        core::levinsonQ31(order, acQ31, arQ24);
+        for (int i=0; i<=order; i++)
+            arErr = max(arErr, (float)abs(ldexp(arQ24[i], -24) - a[i]));
+    }
+    cout << "Autocorrelation: " << (acErr < 1e-6f ? "match" : "differ")
+         << endl;
+    cout << "Levinson: " << (arErr < 1e-3f ? "match" : "differ") << endl;
+
+    // A resonator at 1kHz, 16kHz sampling, as in the cochleas
+    float E = exp(-2.0f * M_PI * 100.0f / 16000);
+    float C = cos(2.0f * M_PI * 1000.0f / 16000);
+    float b[3] = {(1.0f - E*C*2 + E*E) / 4, 0.0f, 0.0f};
+    float d[3] = {1.0f, -E*C*2, E*E};
+    core::BiquadQ15 biquad(b, d);
+    int16_t y[nSamples];
+    int16_t state[4] = {0, 0, 0, 0};
+    biquad(1000, s, y, state);
+    biquad(nSamples-1000, s+1000, y+1000, state);
+    double y1 = 0.0;
+    double y2 = 0.0;
+    double signal = 0.0;
+    double noise = 0.0;
+    for (int i=0; i<nSamples; i++)
+    {
+        double ref = b[0] * s[i] - d[1] * y1 - d[2] * y2;
+        y2 = y1;
+        y1 = ref;
+        signal += ref * ref;
+        noise += (y[i] - ref) * (y[i] - ref);
+    }
+    double snr = 10.0 * log10(signal / noise);
+    cout << "Biquad: " << (snr > 55.0 ? "SNR > 55dB" : "SNR too low") << endl;
+
+    // The framing saturates rather than wraps at -1 by -1
+    int16_t minus[1] = {-32768};
+    int16_t sat[1];
+    core::frameQ15(1, minus, 1, 1, minus, sat, false);
+    cout << "Saturate: " << sat[0] << endl;
+
+    // 16 bit blocks from a file go straight into the framing.  Blocks
+    // arranged as for Frame give the frames of the whole file.
+    PCM pcm;
+    PCMReader whole(&pcm, TEST_DIR "/test.wav", 4096);
+    vector<int16_t> w;
+    vector<int16_t> blk;
+    while (whole.read(blk))
+        w.insert(w.end(), blk.begin(), blk.end());
+    int nWhole = core::frames(w.size(), size, period);
+    vector<float> fw(nWhole*size);
+    vector<int16_t> qw(nWhole*size);
+    core::frame(w.size(), &w[0], size, period, window, &fw[0]);
+    core::frameQ15(w.size(), &w[0], size, period, windowQ15, &qw[0]);
+    int overlap = size - period;
+    PCMReader blocks(
+        &pcm, TEST_DIR "/test.wav", overlap + 50*period, overlap, size/2
+    );
+    int row = 0;
+    bool match = ((long)w.size() == blocks.samples());
+    while (blocks.read(blk))
+    {
+        int n = core::frames(blk.size(), size, period, false);
+        vector<float> fb(n*size);
+        vector<int16_t> qb(n*size);
+        core::frame(
+            blk.size(), blk.data(), size, period, window, fb.data(), false
+        );
+        core::frameQ15(
+            blk.size(), blk.data(), size, period, windowQ15, qb.data(), false
+        );
+        for (int i=0; (i<n*size) && (row*size+i < nWhole*size); i++)
+            match = match &&
+                (fb[i] == fw[row*size+i]) && (qb[i] == qw[row*size+i]);
+        row += n;
+    }
+    cout << "Reader: "
+         << ((row == nWhole) && match ? "match" : "differ") << endl;
+
+    delete [] f;
+    delete [] q;
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include "ssp/htk.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Read back an HTK file in native byte order, as HTKWriter writes it
+ */
+static bool read(
+    const char* iFile, int& oNSamples, int& oPeriod, short& oSize,
+    short& oKind, vector<float>& oData
+)
+{
+    ifstream is(iFile, ios::binary);
+    char h[12];
+    if (!is.read(h, 12))
+        return false;
+    memcpy(&oNSamples, h+0, 4);
+    memcpy(&oPeriod, h+4, 4);
+    memcpy(&oSize, h+8, 2);
+    memcpy(&oKind, h+10, 2);
+    oData.resize((long)oNSamples * oSize / sizeof(float));
+    if (oData.size() == 0)
+        return true;
+    is.read((char*)&oData[0], oData.size() * sizeof(float));
+    return is.gcount() == (long)(oData.size() * sizeof(float)) &&
+        is.peek() == EOF;
+}
+
+/*
+ * Whether the file has the given header and data
+ */
+static bool check(
+    const char* iFile, int iNSamples, int iVecSize, int iKind,
+    const vector<float>& iData
+)
+{
+    int nSamples;
+    int period;
+    short size;
+    short kind;
+    vector<float> data;
+    if (!read(iFile, nSamples, period, size, kind, data))
+        return false;
+    return (nSamples == iNSamples) && (period == 100000) &&
+        (size == iVecSize * (int)sizeof(float)) && (kind == iKind) &&
+        (data == iData);
+}
+
+int main(int argc, char** argv)
+{
+    // Streamed a few frames at a time with no idea of the length, so the
+    // header has to be patched; the second chunk is strided
+    const int vecSize = 3;
+    vector<float> ref;
+    for (int i=0; i<5*vecSize; i++)
+        ref.push_back(i * 0.5f);
+    vector<float> strided(3*(vecSize+2), -1.0f);
+    for (int f=0; f<3; f++)
+        for (int p=0; p<vecSize; p++)
+            strided[f*(vecSize+2)+p] = ref[(f+2)*vecSize+p];
+    {
+        HTKWriter w("test-stream.htk", vecSize, 0.01f, HTK_MFCC | HTK_E);
+        w.write(2, &ref[0]);
+        w.write(3, &strided[0], vecSize+2);
+    }
+    cout << "Stream: "
+         << (check("test-stream.htk", 5, vecSize, HTK_MFCC | HTK_E, ref)
+             ? "match" : "differ") << endl;
+
+    // Gathered from a static matrix and a separate energy column
+    const int nFrames = 4;
+    vector<float> st(nFrames*2);
+    vector<float> en(nFrames*3);
+    vector<float> cat;
+    for (int f=0; f<nFrames; f++)
+    {
+        st[f*2+0] = f;
+        st[f*2+1] = f + 0.25f;
+        en[f*3] = -f;
+        cat.push_back(st[f*2+0]);
+        cat.push_back(st[f*2+1]);
+        cat.push_back(en[f*3]);
+    }
+    HTKWriter::part part[2] = {{&st[0], 2, 2}, {&en[0], 1, 3}};
+    HTKWriter g("test-gather.htk", 3, 0.01f, HTK_USER, nFrames);
+    g.write(nFrames, 2, part);
+    g.close();
+    cout << "Gather: "
+         << (check("test-gather.htk", nFrames, 3, HTK_USER, cat)
+             ? "match" : "differ") << endl;
+
+    // More than the buffer in one go, after a frame that's buffered
+    const int nBig = 20000;
+    vector<float> big(nBig*4);
+    for (int i=0; i<nBig*4; i++)
+        big[i] = i;
+    HTKWriter b("test-big.htk", 4, 0.01f, HTK_FBANK, nBig);
+    b.write(1, &big[0]);
+    b.write(nBig-1, &big[4]);
+    b.close();
+    cout << "Big: "
+         << (check("test-big.htk", nBig, 4, HTK_FBANK, big)
+             ? "match" : "differ") << endl;
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "ssp/ola.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Frame a noise signal with an analysis window, then overlap-add it back
+ * with the same window as synthesis window and normalisation.  Where the
+ * frames fully overlap, i.e., away from the ends, it should reconstruct.
+ */
+static float error(int iSize, int iPeriod, bool iWindow)
+{
+    const int nFrames = 20;
+    int n = (nFrames-1) * iPeriod + iSize;
+    vector<float> x(n);
+    for (int i=0; i<n; i++)
+        x[i] = noise();
+    vector<float> w(iSize, 1.0f);
+    if (iWindow)
+        for (int j=0; j<iSize; j++)
+            w[j] = 0.5f - 0.5f * cos(2 * M_PI * j / iSize);
+    vector<float> f(nFrames*iSize);
+    for (int t=0; t<nFrames; t++)
+        for (int j=0; j<iSize; j++)
+            f[t*iSize+j] = w[j] * x[t*iPeriod+j];
+
+    core::OverlapAdd ola(iSize, iPeriod, iWindow ? &w[0] : 0, true);
+    if (ola.size(nFrames) != n)
+        return 1.0f;
+    vector<float> y(n);
+    ola(nFrames, &f[0], &y[0]);
+    float err = 0.0f;
+    for (int i=iSize; i<n-iSize; i++)
+        err = max(err, abs(y[i] - x[i]));
+    return err;
+}
+
+/*
+ * Pushing frames in uneven chunks then flushing should give exactly the
+ * batch result
+ */
+static bool stream(int iSize, int iPeriod, int& oNSamples)
+{
+    const int nFrames = 23;
+    vector<float> w(iSize);
+    for (int j=0; j<iSize; j++)
+        w[j] = 0.54f - 0.46f * cos(2 * M_PI * j / iSize);
+    vector<float> f(nFrames*iSize);
+    for (int i=0; i<nFrames*iSize; i++)
+        f[i] = noise();
+
+    core::OverlapAdd batch(iSize, iPeriod, &w[0], true);
+    int n = batch.size(nFrames);
+    vector<float> y(n);
+    batch(nFrames, &f[0], &y[0]);
+
+    core::OverlapAdd ola(iSize, iPeriod, &w[0], true);
+    vector<float> s(n);
+    int chunk[] = {1, 5, 2, 7, 8};
+    oNSamples = 0;
+    int t = 0;
+    for (int c=0; t<nFrames; c++)
+    {
+        int m = min(chunk[c%5], nFrames-t);
+        oNSamples += ola.push(m, &f[t*iSize], &s[oNSamples]);
+        t += m;
+    }
+    oNSamples += ola.flush(&s[oNSamples]);
+    return (oNSamples == n) && (s == y);
+}
+
+int main(int argc, char** argv)
+{
+    int shape[][2] = {{400, 160}, {256, 100}, {256, 64}, {300, 75}};
+    for (int i=0; i<4; i++)
+    {
+        int size = shape[i][0];
+        int period = shape[i][1];
+        float er = error(size, period, false);
+        float eh = error(size, period, true);
+        cout << size << "/" << period << ": rectangular "
+             << (er < 1e-5f ? "match" : "differ") << ", hanning "
+             << (eh < 1e-5f ? "match" : "differ") << endl;
+    }
+    int n;
+    bool same = stream(400, 160, n);
+    cout << "Stream: " << n << " samples, " << (same ? "match" : "differ")
+         << endl;
+    return 0;
+}
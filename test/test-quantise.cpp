@@ -0,0 +1,127 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include <lube.h>
+#include "ssp/ssp.h"
+#include "ssp/arfile.h"
+#include "ssp/quantise.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Rows as the quantiser sees them, i.e., with log HNR
+ */
+static var rows(var iParams)
+{
+    var r = paramsToRows(iParams);
+    int nFrames = r.shape(0);
+    int nParams = r.shape(1);
+    float* pr = r.ptr<float>();
+    for (int f=0; f<nFrames; f++)
+        pr[f*nParams+nParams-1] = log(pr[f*nParams+nParams-1]);
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    // Bits of various widths straddling byte boundaries
+    const int nValues = 7;
+    int value[nValues] = {5, 1023, 0, 1, 37, 65535, 12345};
+    int width[nValues] = {3, 10, 1, 1, 6, 16, 14};
+    unsigned char buf[8] = {0};
+    core::BitWriter bw(buf);
+    for (int i=0; i<nValues; i++)
+        bw.put(value[i], width[i]);
+    core::BitReader br(buf);
+    bool same = true;
+    for (int i=0; i<nValues; i++)
+        same = same && (br.get(width[i]) == value[i]);
+    cout << "Bits: " << bw.bits() << ", " << (same ? "match" : "differ")
+         << endl;
+
+    // A uniform scalar quantiser, and LBG on four clusters in 2-D
+    core::Codebook sq;
+    sq.set(1, 3);
+    sq.uniform(0.0f, 8.0f);
+    float v = 3.2f;
+    cout << "Scalar: " << sq.search(&v) << " " << sq.entry(sq.search(&v))[0]
+         << endl;
+    const float centre[4][2] = {{0, 0}, {4, 0}, {0, 1}, {4, 1}};
+    const int nVectors = 400;
+    float data[nVectors*2];
+    for (int i=0; i<nVectors; i++)
+    {
+        data[i*2+0] = centre[i%4][0] + 0.05f * noise();
+        data[i*2+1] = centre[i%4][1] + 0.05f * noise();
+    }
+    core::Codebook vq;
+    vq.set(2, 2);
+    vq.train(nVectors, data, 2);
+    bool found = true;
+    for (int c=0; c<4; c++)
+    {
+        const float* e = vq.entry(vq.search(centre[c]));
+        found = found &&
+            (abs(e[0] - centre[c][0]) < 0.05f) &&
+            (abs(e[1] - centre[c][1]) < 0.05f);
+    }
+    cout << "LBG: " << (found ? "found" : "missed") << " the clusters"
+         << endl;
+
+    // Untrained, each column is scalar quantised over a fixed range, so the
+    // round trip is within half a step
+    const float pi = atan(1.0f) * 4;
+    const int order = 18;
+    const int nFrames = 400;
+    var x = params(nFrames, order);
+    var rx = rows(x);
+    ARQuantiser uq(order);
+    uq.write("test-uniform.arb", x, 16000.0f, 0.005f);
+    var ry = rows(uq.read("test-uniform.arb"));
+    float step[order+3];
+    for (int p=0; p<order; p++)
+        step[p] = pi / 32;
+    step[order+0] = 32.0f / 64;
+    step[order+1] = log(500.0f / 40.0f) / 64;
+    step[order+2] = 20.0f / 16;
+    float* px = rx.ptr<float>();
+    float* py = ry.ptr<float>();
+    bool within = (ry.shape(0) == nFrames);
+    for (int f=0; f<nFrames; f++)
+        for (int p=0; p<order+3; p++)
+            within = within &&
+                (abs(px[f*(order+3)+p] - py[f*(order+3)+p]) <=
+                 step[p] / 2 + 1e-4f);
+    cout << "Uniform: " << uq.bitsPerFrame() << " bits, "
+         << (within ? "within half a step" : "too far") << endl;
+
+    // Trained, the LSPs are three splits of six columns; the saved
+    // codebooks should decode identically
+    ARQuantiser tq(order);
+    tq.train(x);
+    tq.save("test-codebook.txt");
+    ARQuantiser lq(order);
+    lq.load("test-codebook.txt");
+    tq.write("test-trained.arb", x, 16000.0f, 0.005f);
+    var rt = rows(tq.read("test-trained.arb"));
+    var rl = rows(lq.read("test-trained.arb"));
+    float* pt = rt.ptr<float>();
+    float* pl = rl.ptr<float>();
+    bool loaded = (lq.bitsPerFrame() == tq.bitsPerFrame());
+    for (int i=0; i<nFrames*(order+3); i++)
+        loaded = loaded && (pt[i] == pl[i]);
+    cout << "Trained: " << tq.bitsPerFrame() << " bits, load "
+         << (loaded ? "match" : "differ") << endl;
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include <lube.h>
+#include "ssp/ssp.h"
+#include "ssp/arcodec.h"
+
+using namespace std;
+using namespace ssp;
+
+/*
+ * Largest absolute difference of two float arrays of the same size
+ */
+static float maxDiff(var iA, var iB)
+{
+    if (iA.size() != iB.size())
+        return 1e30f;
+    float* a = iA.ptr<float>();
+    float* b = iB.ptr<float>();
+    float d = 0.0f;
+    for (int i=0; i<iA.size(); i++)
+        d = max(d, abs(a[i] - b[i]));
+    return d;
+}
+
+/*
+ * Block reading versus reading the whole file.  The blocks are arranged so
+ * that framing each without padding gives the frames of the whole file, and
+ * so that ARCodec encodes them to the frames of the whole file.
+ */
+int main(int argc, char** argv)
+{
+    const int size = 400;
+    const int period = 80;
+    const int nPerBlock = 50;
+    int pad = size/2;
+    int overlap = size - period;
+    int block = overlap + nPerBlock*period;
+
+    PCM pcm;
+    var a = pcm.read(TEST_DIR "/test.wav");
+    int n = a.size();
+    float* x = a.ptr<float>();
+    Frame whole(size, period);
+    var fw = whole(a);
+    int nFrames = fw.shape(0);
+    float* pw = fw.ptr<float>();
+
+    PCMReader reader(&pcm, TEST_DIR "/test.wav", block, overlap, pad);
+    Frame part(size, period, false);
+    var b;
+    long pos = 0;
+    int frame = 0;
+    float blockErr = 0.0f;
+    float frameErr = 0.0f;
+    while (reader.read(b))
+    {
+        float* pb = b.ptr<float>();
+        for (int i=0; i<b.size(); i++)
+        {
+            long j = std::min<long>(std::max<long>(pos+i-pad, 0), n-1);
+            blockErr = max(blockErr, abs(pb[i] - x[j]));
+        }
+        if (b.size() >= size)
+        {
+            var fb = part(b);
+            float* pf = fb.ptr<float>();
+            for (int i=0; (i<fb.size()) && (frame*size+i < fw.size()); i++)
+                frameErr = max(frameErr, abs(pf[i] - pw[frame*size+i]));
+            frame += fb.shape(0);
+        }
+        pos += block - overlap;
+    }
+    cout << "Samples: " << (reader.samples() == n ? "match" : "differ")
+         << endl;
+    cout << "Blocks: " << (blockErr < 1e-6f ? "match" : "differ") << endl;
+    cout << "Frames: " << ((frame == nFrames) && (frameErr < 1e-6f)
+                           ? "match" : "differ") << endl;
+
+    // After a seek, the time is pad samples into the next block
+    reader.seek(0.5f);
+    reader.read(b);
+    long t = pcm.secondsToSamples(0.5f, PCM::EXACT);
+    float seekErr = 0.0f;
+    for (int i=0; i<block; i++)
+        seekErr = max(seekErr, abs(b.ptr<float>()[i] - x[t-pad+i]));
+    cout << "Seek: " << (seekErr < 1e-6f ? "match" : "differ") << endl;
+
+    // At another pcm rate, the blocks are of the file as PCM::read()
+    // resamples it, including after a seek
+    lube::Config cnf;
+    cnf.configFile(TEST_DIR "/test-reader.ini");
+    PCM pcm8("Reader8k");
+    var a8 = pcm8.read(TEST_DIR "/test.wav");
+    int n8 = a8.size();
+    float* x8 = a8.ptr<float>();
+    PCMReader reader8(&pcm8, TEST_DIR "/test.wav", block, overlap, pad);
+    float resampleErr = 0.0f;
+    pos = 0;
+    while (reader8.read(b))
+    {
+        float* pb = b.ptr<float>();
+        for (int i=0; i<b.size(); i++)
+        {
+            long j = std::min<long>(std::max<long>(pos+i-pad, 0), n8-1);
+            resampleErr = max(resampleErr, abs(pb[i] - x8[j]));
+        }
+        pos += block - overlap;
+    }
+    reader8.seek(0.5f);
+    reader8.read(b);
+    t = pcm8.secondsToSamples(0.5f, PCM::EXACT);
+    for (int i=0; i<b.size(); i++)
+    {
+        long j = std::min<long>(t-pad+i, n8-1);
+        resampleErr = max(resampleErr, abs(b.ptr<float>()[i] - x8[j]));
+    }
+    cout << "Resampled: "
+         << ((pcm8.rate() == 8000) && (reader8.samples() == n8) &&
+             (resampleErr < 1e-5f) ? "match" : "differ") << endl;
+
+    // Encoding a block at a time; the pitch is smoothed per block, so only
+    // the excitation of the oracle codec matches as well as the filters
+    for (int oracle=0; oracle<2; oracle++)
+    {
+        ARCodec arcodec(&pcm, oracle);
+        int p = arcodec.period();
+        int c = arcodec.context();
+        PCMReader creader(
+            &pcm, TEST_DIR "/test.wav", c*2 - p + 40*p, c*2 - p, c
+        );
+        var whole = arcodec.encode(a);
+        var blocks = arcodec.encode(creader);
+        float gainErr = 0.0f;
+        float* gw = whole[1].ptr<float>();
+        float* gb = blocks[1].ptr<float>();
+        for (int i=0; i<whole[1].size(); i++)
+            gainErr = max(gainErr, abs(gb[i] - gw[i]) / max(gw[i], 1e-10f));
+        bool match = (maxDiff(whole[0], blocks[0]) < 1e-3f) &&
+            (whole[1].size() == blocks[1].size()) && (gainErr < 1e-3f);
+        if (oracle)
+            match = match && (maxDiff(whole[2], blocks[2]) < 1e-3f);
+        cout << (oracle ? "Oracle encode: " : "Encode: ")
+             << (match ? "match" : "differ") << endl;
+    }
+
+    return 0;
+}
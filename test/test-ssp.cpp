@@ -7,10 +7,14 @@
  *   Phil Garner, December 2013
  */
 
+#include <cmath>
 #include <lube.h>
 #include "ssp/ssp.h"
 #include "ssp/ar.h"
 #include "ssp/window.h"
+#include "ssp/pitch.h"
+#include "ssp/filter.h"
+#include "test.h"
 
 using namespace std;
 using namespace ssp;
@@ -144,6 +148,125 @@ ans =
     var psl = frlsp(lsp);
     cout << "AR:  " << psl << endl;
 
+    // Double input.  A high order frame with a little noise; the double
+    // chain is the reference for plain and mixed precision float.  Mixed
+    // should be nearer to it than plain float in both stages.
+    int hiOrder = 40;
+    int hiSize = 400;
+    var hf = lube::view({hiSize}, 0.0f);
+    var hd = lube::view({hiSize}, 0.0);
+    float* phf = hf.ptr<float>();
+    double* phd = hd.ptr<double>();
+    unsigned int seed = 1;
+    for (int i=0; i<hiSize; i++)
+    {
+        float v = 0.0f;
+        for (int h=1; h<=10; h++)
+            v += sin(2 * M_PI * 150 * h * i / 16000) / h;
+        phf[i] = 0.1f * v + 1e-4f * noise(seed);
+        phd[i] = phf[i];
+    }
+    Autocorrelation hac(hiOrder+1);
+    Autocorrelation mac(hiOrder+1, true);
+    Levinson hlev(hiOrder);
+    Levinson mlev(hiOrder, 0.0f, true);
+    var acd = hac(hd);
+    var acf = hac(hf);
+    var acm = mac(hf);
+    var ard = hlev(acd);
+    var arm = mlev(acm);
+    double* pacd = acd.ptr<double>();
+    float* pacf = acf.ptr<float>();
+    float* pacm = acm.ptr<float>();
+    double* pard = ard.ptr<double>();
+    float* parm = arm.ptr<float>();
+    float acErrF = 0.0f;
+    float acErrM = 0.0f;
+    float chainErr = 0.0f;
+    for (int i=0; i<=hiOrder; i++)
+    {
+        acErrF = max(acErrF, (float)abs(pacf[i] - pacd[i]));
+        acErrM = max(acErrM, (float)abs(pacm[i] - pacd[i]));
+        chainErr = max(chainErr, (float)abs(parm[i] - pard[i]));
+    }
+    cout << "Double chain: "
+         << ((ard.atype() == lube::TYPE_DOUBLE) && (chainErr < 1e-3f)
+             ? "match" : "differ") << endl;
+    cout << "Mixed AC: "
+         << (acErrM < acErrF ? "nearer double" : "no nearer") << endl;
+
+    // Levinson on the same (float) autocorrelation in each precision
+    var acmd = lube::view({hiOrder+1}, 0.0);
+    double* pacmd = acmd.ptr<double>();
+    for (int i=0; i<=hiOrder; i++)
+        pacmd[i] = pacm[i];
+    var arf = hlev(acm);
+    var armd = hlev(acmd);
+    float* parf = arf.ptr<float>();
+    double* parmd = armd.ptr<double>();
+    float levErrF = 0.0f;
+    float levErrM = 0.0f;
+    for (int i=0; i<=hiOrder; i++)
+    {
+        levErrF = max(levErrF, (float)abs(parf[i] - parmd[i]));
+        levErrM = max(levErrM, (float)abs(parm[i] - parmd[i]));
+    }
+    cout << "Mixed Levinson: "
+         << (levErrM < levErrF ? "nearer double" : "no nearer") << endl;
+
+    // LSPs of a double polynomial stay double and come back
+    var dpyar = lube::view({5}, 0.0);
+    double* pdpyar = dpyar.ptr<double>();
+    for (int i=0; i<5; i++)
+        pdpyar[i] = pyar[i].cast<double>();
+    var dpsl = frlsp(tolsp(dpyar));
+    double* pdpsl = dpsl.ptr<double>();
+    float lspErr = 0.0f;
+    for (int i=0; i<5; i++)
+        lspErr = max(lspErr, (float)abs(pdpsl[i] - pdpyar[i]));
+    cout << "Double LSP: "
+         << ((dpsl.atype() == lube::TYPE_DOUBLE) && (lspErr < 1e-5f)
+             ? "match" : "differ") << endl;
+
+    // The continuous excitation should be as long as the overlap-add of the
+    // framed one, and lspSynthesis with constant LSPs and gain is then just
+    // one filter
+    const int nSyn = 10;
+    const int synPeriod = 80;
+    var cpitch(nSyn, 120.0f);
+    var chnr(nSyn, 5.0f);
+    var cex = excitation(cpitch, chnr, &pcm, synPeriod, false);
+    OverlapAdd sola;
+    var fex = sola(excitation(cpitch, chnr, &pcm, synPeriod));
+    cout << "Excitation length: "
+         << ((cex.size() == fex.size()) ? "match" : "differ") << endl;
+    var clsp1;
+    clsp1 = 0.0f, 0.4f, 0.7f, 1.5f, 2.2f, (float)M_PI;
+    var clsp = lube::view({nSyn, 6}, 0.0f);
+    float* pclsp = clsp.ptr<float>();
+    for (int f=0; f<nSyn; f++)
+        for (int k=0; k<6; k++)
+            pclsp[f*6+k] = clsp1[k].cast<float>();
+    var cgain(nSyn, 0.25f);
+    var syn = lspSynthesis(cex, clsp, cgain, synPeriod, 16);
+    var car = frlsp(clsp1);
+    float cb = 0.5f;
+    core::Filter cf(1, &cb, 5, car.ptr<float>());
+    var cref(cex.size(), 0.0f);
+    cf(cex.size(), cex.ptr<float>(), cref.ptr<float>());
+    float* psyn = syn.ptr<float>();
+    float* pcref = cref.ptr<float>();
+    float synPeak = 0.0f;
+    float synErr = 0.0f;
+    for (int i=0; i<cex.size(); i++)
+    {
+        synPeak = max(synPeak, abs(pcref[i]));
+        synErr = max(synErr, abs(psyn[i] - pcref[i]));
+    }
+    cout << "lspSynthesis: "
+         << ((syn.size() == cex.size()) && (synErr < 1e-4f * synPeak)
+             ? "match" : "differ") << endl;
+
     // HTK files
     lube::filemodule htkm("htk");
     lube::file& htk = htkm.create();
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#include <iostream>
+#include <cmath>
+#include <lube.h>
+#include "ssp/ssp.h"
+#include "ssp/vad.h"
+#include "ssp/ar.h"
+#include "ssp/arcodec.h"
+#include "test.h"
+
+using namespace std;
+using namespace ssp;
+
+const int rate = 16000;
+const int size = 400;
+const int period = 160;
+const int hangover = 10;
+
+/*
+ * Whether the mask is iValue for all frames centred in [iBeg, iEnd) seconds
+ */
+static bool all(var iMask, float iBeg, float iEnd, float iValue)
+{
+    int nFrames = iMask.size();
+    bool ret = true;
+    for (int i=0; i<nFrames; i++)
+    {
+        float t = (float)(i * period) / rate;
+        if ((t >= iBeg) && (t < iEnd))
+            ret = ret && (iMask[i].cast<float>() == iValue);
+    }
+    return ret;
+}
+
+/*
+ * A noise floor with loud voiced segments, then a quiet voiced segment and a
+ * quiet noise burst at the same level, between the thresholds.
+ */
+int main(int argc, char** argv)
+{
+    int n = rate * 2;
+    var x(n, 0.0f);
+    float* px = x.ptr<float>();
+    const float pi = atan(1.0f) * 4;
+    for (int i=0; i<n; i++)
+    {
+        float t = (float)i / rate;
+        px[i] = 0.001f * noise();
+        float v = 0.0f;
+        for (int h=1; h<=5; h++)
+            v += sin(2 * pi * 150 * h * t) / h;
+        if (((t >= 0.5f) && (t < 0.8f)) || ((t >= 1.2f) && (t < 1.4f)))
+            px[i] += 0.1f * v;
+        if ((t >= 1.6f) && (t < 1.7f))
+            px[i] += 0.002f * sin(2 * pi * 200 * t);
+        if ((t >= 1.85f) && (t < 1.95f))
+            px[i] += 0.0024f * noise();
+    }
+
+    Frame frame(size, period);
+    Autocorrelation ac(3);
+    VAD vad(9.0f, 3.0f, hangover);
+    var mask = vad(ac(frame(x)));
+
+    // Hangover is 10 frames, i.e., 0.1 s, from the last frame touching the
+    // speech
+    float hold = (float)(hangover * period) / rate;
+    float edge = (float)size / rate;
+    cout << "Background: "
+         << (all(mask, 0.0f, 0.5f - edge, 0.0f) &&
+             all(mask, 0.8f + edge + hold, 1.2f - edge, 0.0f)
+             ? "rejected" : "detected") << endl;
+    cout << "Loud: "
+         << (all(mask, 0.5f, 0.8f, 1.0f) && all(mask, 1.2f, 1.4f, 1.0f)
+             ? "detected" : "rejected") << endl;
+    cout << "Hangover: "
+         << (all(mask, 0.8f, 0.8f + hold, 1.0f) ? "held" : "dropped")
+         << endl;
+    cout << "Quiet voiced: "
+         << (all(mask, 1.6f + edge, 1.7f - edge, 1.0f)
+             ? "detected" : "rejected") << endl;
+    cout << "Quiet noise: "
+         << (all(mask, 1.85f, 1.95f, 0.0f) ? "rejected" : "detected")
+         << endl;
+
+    // Compact and expand the speech frames
+    var f = frame(x);
+    int nFrames = f.shape(0);
+    var c = lube::view({nFrames, size}, 0.0f);
+    int nSpeech = compact(mask, f, c);
+    var e = lube::view({nFrames, size}, 0.0f);
+    expand(mask, c, e);
+    float* pm = mask.ptr<float>();
+    float* pf = f.ptr<float>();
+    float* pe = e.ptr<float>();
+    float err = 0.0f;
+    for (int i=0; i<nFrames*size; i++)
+    {
+        float d = (pm[i/size] > 0.0f) ? pe[i] - pf[i] : pe[i];
+        err = max(err, abs(d));
+    }
+    cout << "Compact: "
+         << ((nSpeech > 0) && (nSpeech < nFrames) && (err == 0.0f)
+             ? "match" : "differ") << endl;
+
+    // Speech throughout, varying by a few dB, has no floor to drop
+    var y(n, 0.0f);
+    float* py = y.ptr<float>();
+    for (int i=0; i<n; i++)
+    {
+        float t = (float)i / rate;
+        float v = 0.0f;
+        for (int h=1; h<=5; h++)
+            v += sin(2 * pi * 150 * h * t) / h;
+        py[i] = 0.1f * (1.0f + 0.4f * sin(2 * pi * 2 * t)) * v;
+    }
+    var ymask = vad(ac(frame(y)));
+    cout << "All speech: "
+         << (all(ymask, 0.0f, 2.0f, 1.0f) ? "detected" : "dropped") << endl;
+
+    // The codec with VAD should agree with the codec without it on speech,
+    // and have flat filters at the energy of the frame elsewhere
+    PCM pcm;
+    ARCodec full(&pcm);
+    ARCodec skip(&pcm, false, false, false, true);
+    var pFull = full.encode(x);
+    var pSkip = skip.encode(x);
+    var cmask = skip.mask();
+    int nCodec = cmask.size();
+    int order = arorder(pcm.rate());
+    int cols = order+2;
+    float* pm2 = cmask.ptr<float>();
+    float* lFull = pFull[0].ptr<float>();
+    float* lSkip = pSkip[0].ptr<float>();
+    float* gFull = pFull[1].ptr<float>();
+    float* gSkip = pSkip[1].ptr<float>();
+    float* hSkip = pSkip[3].ptr<float>();
+    int cSize = pcm.secondsToSamples(0.01, PCM::AT_LEAST);
+    Frame cframe(cSize, cSize/2);
+    var cf = cframe(x);
+    var w = hanning(cSize+1);
+    w.pop();
+    cf *= w;
+    Autocorrelation cac(order+1, true);
+    var energy = cac(cf);
+    float* pEnergy = energy.ptr<float>();
+    int nCodecSpeech = 0;
+    bool speechMatch = true;
+    bool silenceFlat = true;
+    for (int i=0; i<nCodec; i++)
+    {
+        if (pm2[i] > 0.0f)
+        {
+            nCodecSpeech++;
+            speechMatch = speechMatch && (gSkip[i] == gFull[i]);
+            for (int j=0; j<cols; j++)
+                speechMatch = speechMatch &&
+                    (lSkip[i*cols+j] == lFull[i*cols+j]);
+        }
+        else
+        {
+            silenceFlat = silenceFlat && (hSkip[i] == 0.0f);
+            silenceFlat = silenceFlat &&
+                (gSkip[i] == pEnergy[i*(order+1)]);
+            for (int j=0; j<cols; j++)
+                silenceFlat = silenceFlat &&
+                    (abs(lSkip[i*cols+j] - pi * j / (order+1)) < 1e-6f);
+        }
+    }
+    cout << "Codec mask: "
+         << ((nCodecSpeech > 0) && (nCodecSpeech < nCodec)
+             ? "mixed" : "uniform") << endl;
+    cout << "Codec speech: " << (speechMatch ? "match" : "differ") << endl;
+    cout << "Codec silence: " << (silenceFlat ? "flat" : "shaped") << endl;
+
+    // Absolutely, on white noise the gain is the prediction error power,
+    // a little under the windowed signal power over the last frameSize -
+    // order samples, as Autocorrelation normalises lag 0.  A tone adds an
+    // LSP pair either side of its frequency.
+    var z(n, 0.0f);
+    float* pz = z.ptr<float>();
+    for (int i=0; i<n; i++)
+        pz[i] = 0.1f * noise();
+    float w2 = 0.0f;
+    for (int j=order; j<cSize; j++)
+        w2 += w[j].cast<float>() * w[j].cast<float>();
+    w2 /= cSize - order;
+    var pz0 = full.encode(z);
+    float* gz = pz0[1].ptr<float>();
+    int nz = pz0[1].size();
+    float ratio = 0.0f;
+    for (int i=0; i<nz; i++)
+        ratio += gz[i] / (0.01f / 3 * w2);
+    ratio /= nz;
+    for (int i=0; i<n; i++)
+        pz[i] = 0.001f * noise() + 0.1f * sin(2 * pi * 1000 * i / rate);
+    var pz1 = full.encode(z);
+    float* lz = pz1[0].ptr<float>() + (nz/2) * cols;
+    float tone = 2 * pi * 1000 / rate;
+    float near = pi;
+    for (int j=0; j<cols; j++)
+        near = min(near, abs(lz[j] - tone));
+    cout << "Codec gain: "
+         << ((ratio > 0.7f) && (ratio < 1.05f) ? "frame power" : "wrong")
+         << endl;
+    cout << "Codec LSP: " << (near < 0.05f ? "at tone" : "off tone") << endl;
+
+    // Once both have run, another round shouldn't resize the working arrays
+    var params;
+    var output;
+    full.decode(pFull, output);
+    skip.decode(pSkip, output);
+    long allocs = Scratch::allocs();
+    full.encode(x, params);
+    full.decode(params, output);
+    skip.encode(x, params);
+    skip.decode(params, output);
+    cout << "Codec scratch: "
+         << (Scratch::allocs() == allocs ? "settled" : "reallocated") << endl;
+
+    return 0;
+}
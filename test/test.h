@@ -0,0 +1,66 @@
+/*
+ * Copyright 2016 by Idiap Research Institute, http://www.idiap.ch
+ *
+ * See the file COPYING for the licence associated with this software.
+ *
+ * Author(s):
+ *   Phil Garner, October 2016
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <cmath>
+#include <lube.h>
+
+/*
+ * Things shared by the tests
+ */
+
+/*
+ * Uniform noise in +/-1 from a fixed generator, so the output doesn't
+ * depend on the library.  The first form runs its own sequence from ioSeed;
+ * the second is one sequence for the whole test.
+ */
+inline float noise(unsigned int& ioSeed)
+{
+    ioSeed = ioSeed * 1664525u + 1013904223u;
+    return (float)ioSeed / 2147483648.0f - 1.0f;
+}
+
+inline float noise()
+{
+    static unsigned int seed = 1;
+    return noise(seed);
+}
+
+/*
+ * Plausible {lsp, gain, f0, hnr} parameters, as from ARCodec::encode(), all
+ * inside the ranges of the untrained quantiser
+ */
+inline lube::var params(int iNFrames, int iOrder)
+{
+    const float pi = std::atan(1.0f) * 4;
+    lube::var lsp = lube::view({iNFrames, iOrder+2}, 0.0f);
+    lube::var g(iNFrames, 0.0f);
+    lube::var f0(iNFrames, 0.0f);
+    lube::var hnr(iNFrames, 0.0f);
+    float* pl = lsp.ptr<float>();
+    float* pg = g.ptr<float>();
+    float* pf = f0.ptr<float>();
+    float* ph = hnr.ptr<float>();
+    for (int f=0; f<iNFrames; f++)
+    {
+        float* l = pl + f*(iOrder+2);
+        l[0] = 0.0f;
+        for (int p=1; p<=iOrder; p++)
+            l[p] = pi * p / (iOrder+1) + 0.02f * noise();
+        l[iOrder+1] = pi;
+        pg[f] = std::exp(-5.0f + noise());
+        pf[f] = 150.0f + 50.0f * noise();
+        ph[f] = std::exp(2.0f * noise());
+    }
+    return {lsp, g, f0, hnr};
+}
+
+#endif // TEST_H
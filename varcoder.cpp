@@ -7,13 +7,38 @@
  *   Phil Garner, February 2015
  */
 
+#include <algorithm>
+#include <fstream>
+#include <iostream>
 #include <lube.h>
 #include <lube/config.h>
 #include "ssp/arcodec.h"
+#include "ssp/ar.h"
+#include "ssp/arfile.h"
+#include "ssp/quantise.h"
+#include "ssp/profile.h"
 
 using namespace std;
 using namespace ssp;
 
+/*
+ * Encode the whole file at once, or, given a block size in seconds, read
+ * and encode it a block at a time with enough context for each block's
+ * frames.
+ */
+static var encodeFile(ARCodec& iCodec, PCM& iPCM, var iFile, float iBlock)
+{
+    if (iBlock <= 0.0f)
+        return iCodec.encode(iPCM.read(iFile));
+    int period = iCodec.period();
+    int overlap = iCodec.context()*2 - period;
+    int nPerBlock = max(1, iPCM.secondsToSamples(iBlock, PCM::EXACT) / period);
+    PCMReader reader(
+        &iPCM, iFile, overlap + nPerBlock*period, overlap, iCodec.context()
+    );
+    return iCodec.encode(reader);
+}
+
 int main(int argc, char** argv)
 {
     // Command line
@@ -22,7 +47,13 @@ int main(int argc, char** argv)
     opt('e', "Read a wave file and encode as parameters");
     opt('d', "Read parameters and decode");
     opt('o', "Use the oracle excitation in the AR codec");
+    opt('i', "Decode with interpolated LSPs rather than overlap-add");
+    opt('y', "Track pitch with the YIN difference function");
+    opt('v', "Only analyse the frames that voice activity detection keeps");
+    opt('b', "Read and encode blocks of this many seconds; 0 is all", "0");
+    opt('t', "Train quantiser codebooks on wave files into the last file");
     opt('C', "Read configuration file", "/dev/null");
+    opt('p', "Write per-stage timings as JSON to file", "/dev/null");
     opt("Default behaviour is a best-effort encode-decode copy");
     opt.parse(argc, argv);
 
@@ -36,19 +67,52 @@ int main(int argc, char** argv)
     if (arg.size() < 2)
         opt.usage(0);
 
+    if (opt['t'])
+    {
+        // Encode all the input files and train on the lot
+        PCM pcm;
+        ARCodec arcodec(&pcm);
+        var cbfile = arg.pop();
+        var rows;
+        int nFrames = 0;
+        for (int i=0; i<arg.size(); i++)
+        {
+            var r = paramsToRows(arcodec.encode(pcm.read(arg[i])));
+            nFrames += r.shape(0);
+            rows.push(r);
+        }
+        int nParams = rows[0].shape(1);
+        var all = lube::view({nFrames, nParams}, 0.0f);
+        float* a = all.ptr<float>();
+        for (int i=0; i<rows.size(); i++)
+        {
+            int n = rows[i].shape(0) * nParams;
+            float* r = rows[i].ptr<float>();
+            for (int j=0; j<n; j++)
+                *a++ = r[j];
+        }
+        ARQuantiser arq(arorder(pcm.rate()));
+        arq.train(rowsToParams(all));
+        arq.save(cbfile);
+        return 0;
+    }
+
     // The input and output should be the last two arguments
     var ofile = arg.pop();
     var ifile = arg.pop();
 
     // AR codec
     PCM pcm;
-    ARCodec arcodec(&pcm, bool(opt['o']));
+    ARCodec arcodec(
+        &pcm, bool(opt['o']), bool(opt['i']), bool(opt['y']), bool(opt['v'])
+    );
+
+    float block = opt['b'].cast<float>();
 
     if (!opt['e'] && !opt['d'])
     {
         // Best effort copy synthesis
-        var a = pcm.read(ifile);
-        var params = arcodec.encode(a);
+        var params = encodeFile(arcodec, pcm, ifile, block);
         var signal = arcodec.decode(params);
         pcm.write(ofile, signal);
     }
@@ -56,8 +120,7 @@ int main(int argc, char** argv)
     if (opt['e'])
     {
         // Read the file, hanging on to the attributes
-        var a = pcm.read(ifile);
-        var params = arcodec.encode(a);
+        var params = encodeFile(arcodec, pcm, ifile, block);
         arcodec.write(ofile, params);
     }
 
@@ -69,6 +132,15 @@ int main(int argc, char** argv)
         pcm.write(ofile, signal);
     }
 
+    // Stage timings; only populated if the library is built with SSP_PROFILE
+    if (opt['p'] != "/dev/null")
+    {
+        if (!profile::enabled())
+            std::cerr << "varcoder: built without SSP_PROFILE" << std::endl;
+        std::ofstream os(opt['p'].str());
+        os << profile::json();
+    }
+
     // Done
     return 0;
 }